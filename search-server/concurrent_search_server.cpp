@@ -0,0 +1,173 @@
+#include "concurrent_search_server.h"
+
+#include <utility>
+
+ConcurrentSearchServer::ConcurrentSearchServer(SearchServer search_server)
+	: published_(std::make_shared<SearchServer>(std::move(search_server)))
+{
+	snapshot_ = published_;
+}
+
+ConcurrentSearchServer::Snapshot ConcurrentSearchServer::GetSnapshot() const {
+	return std::atomic_load(&snapshot_);
+}
+
+uint64_t ConcurrentSearchServer::GetVersion() const {
+	return version_;
+}
+
+std::vector<Document> ConcurrentSearchServer::FindTopDocuments(std::string_view raw_query,
+	DocumentStatus status, const SearchOptions & options) const
+{
+	return GetSnapshot()->FindTopDocuments(raw_query, status, options);
+}
+
+int ConcurrentSearchServer::GetDocumentCount() const {
+	return GetSnapshot()->GetDocumentCount();
+}
+
+void ConcurrentSearchServer::AddDocument(int document_id, std::string_view document,
+	DocumentStatus status, const std::vector<int> & ratings)
+{
+	Apply([document_id, text = std::string(document), status, ratings](SearchServer & search_server) {
+		search_server.AddDocument(document_id, text, status, ratings);
+	});
+}
+
+void ConcurrentSearchServer::AddDocuments(const std::vector<DocumentRecord> & documents) {
+	// Изменение переживает вызов, поэтому тексты копируются
+	std::vector<std::string> texts;
+	texts.reserve(documents.size());
+	for (const DocumentRecord & document : documents) {
+		texts.emplace_back(document.text);
+	}
+	Apply([texts = std::move(texts), documents](SearchServer & search_server) {
+		std::vector<DocumentRecord> records = documents;
+		for (size_t i = 0; i < records.size(); ++i) {
+			records[i].text = texts[i];
+		}
+		search_server.AddDocuments(records);
+	});
+}
+
+void ConcurrentSearchServer::RemoveDocument(int document_id) {
+	Apply([document_id](SearchServer & search_server) {
+		search_server.RemoveDocument(document_id);
+	});
+}
+
+void ConcurrentSearchServer::RemoveDocuments(const std::vector<int> & document_ids) {
+	Apply([document_ids](SearchServer & search_server) {
+		search_server.RemoveDocuments(document_ids);
+	});
+}
+
+void ConcurrentSearchServer::SetDocumentSet(const std::string & name, const std::vector<int> & document_ids) {
+	Apply([name, document_ids](SearchServer & search_server) {
+		search_server.SetDocumentSet(name, document_ids);
+	});
+}
+
+void ConcurrentSearchServer::RemoveDocumentSet(std::string_view name) {
+	Apply([name = std::string(name)](SearchServer & search_server) {
+		search_server.RemoveDocumentSet(name);
+	});
+}
+
+void ConcurrentSearchServer::Update(Change change) {
+	Apply(std::move(change));
+}
+
+void ConcurrentSearchServer::Publish() {
+	std::lock_guard guard(writer_mutex_);
+	if (!writer_) {
+		return;
+	}
+	if (is_standby_stale_) {
+		is_standby_stale_ = false;
+		standby_.reset();
+		standby_changes_.clear();
+	} else {
+		standby_ = std::move(published_);
+		standby_changes_ = std::move(writer_changes_);
+	}
+	writer_changes_.clear();
+	published_ = std::move(writer_);
+	std::atomic_store(&snapshot_, Snapshot(published_));
+	++version_;
+}
+
+void ConcurrentSearchServer::Compact() {
+	std::lock_guard compaction_guard(compaction_mutex_);
+	Snapshot base;
+	{
+		std::lock_guard guard(writer_mutex_);
+		// Сжимаемая копия должна получить и изменения, еще не опубликованные к этому моменту
+		base = published_;
+		compaction_changes_ = writer_changes_;
+		is_compacting_ = true;
+	}
+	// Опубликованный сервер не меняется, пока на него есть ссылка, поэтому копируется без блокировки
+	std::shared_ptr<SearchServer> compacted;
+	try {
+		compacted = std::make_shared<SearchServer>(*base);
+		compacted->Compact();
+	} catch (...) {
+		std::lock_guard guard(writer_mutex_);
+		is_compacting_ = false;
+		compaction_changes_.clear();
+		throw;
+	}
+	base.reset();
+
+	std::lock_guard guard(writer_mutex_);
+	is_compacting_ = false;
+	const std::vector<Change> changes = std::move(compaction_changes_);
+	compaction_changes_.clear();
+	try {
+		for (const Change & change : changes) {
+			change(*compacted);
+		}
+	} catch (...) {
+		// Изменения уже применялись без исключений, поэтому копия писателя остается прежней
+		return;
+	}
+	writer_ = std::move(compacted);
+	standby_.reset();
+	standby_changes_.clear();
+	is_standby_stale_ = true;
+}
+
+void ConcurrentSearchServer::Apply(Change change) {
+	std::lock_guard guard(writer_mutex_);
+	change(GetWriter());
+	if (is_compacting_) {
+		compaction_changes_.push_back(change);
+	}
+	writer_changes_.push_back(std::move(change));
+}
+
+SearchServer & ConcurrentSearchServer::GetWriter() {
+	if (writer_) {
+		return *writer_;
+	}
+	// Снимок предыдущей версии держат только standby_ и читатели. Новые читатели
+	// его уже не получат, поэтому единственная ссылка означает, что чтение закончено
+	if (standby_ && standby_.use_count() == 1) {
+		std::atomic_thread_fence(std::memory_order_acquire);
+		try {
+			for (const Change & change : standby_changes_) {
+				change(*standby_);
+			}
+			writer_ = std::move(standby_);
+		} catch (...) {
+			writer_.reset();
+		}
+	}
+	if (!writer_) {
+		writer_ = std::make_shared<SearchServer>(*published_);
+	}
+	standby_.reset();
+	standby_changes_.clear();
+	return *writer_;
+}
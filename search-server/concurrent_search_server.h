@@ -0,0 +1,86 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "search_server.h"
+
+// Сервер для поиска одновременно с изменением документов (read-copy-update).
+// Читатели берут неизменяемый снимок сервера и работают с ним без блокировок писателя.
+// Единственный одновременно работающий писатель меняет свою копию сервера, а Publish
+// атомарно подменяет снимок. Старый снимок освобождается, когда его отпускает последний
+// читатель. Копия писателя получается из старого снимка повторением изменений после
+// публикации, если снимок уже никто не читает, иначе - полным копированием
+class ConcurrentSearchServer {
+public:
+	using Snapshot = std::shared_ptr<const SearchServer>;
+	using Change = std::function<void(SearchServer &)>;
+
+	explicit ConcurrentSearchServer(SearchServer search_server);
+
+	// Текущий опубликованный снимок. Снимок не меняется, пока его держит читатель.
+	// Результаты MatchDocument ссылаются на слова снимка и действительны, пока он жив
+	Snapshot GetSnapshot() const;
+	// Номер опубликованной версии, растет с каждой публикацией изменений
+	uint64_t GetVersion() const;
+
+	std::vector<Document> FindTopDocuments(std::string_view raw_query,
+		DocumentStatus status = DocumentStatus::ACTUAL, const SearchOptions & options = SearchOptions{}) const;
+	int GetDocumentCount() const;
+
+	// Изменения не видны читателям до Publish. Если метод сервера выбросил исключение,
+	// изменение не запоминается
+	void AddDocument(int document_id, std::string_view document,
+		DocumentStatus status, const std::vector<int> & ratings);
+	void AddDocuments(const std::vector<DocumentRecord> & documents);
+	void RemoveDocument(int document_id);
+	void RemoveDocuments(const std::vector<int> & document_ids);
+	void SetDocumentSet(const std::string & name, const std::vector<int> & document_ids);
+	void RemoveDocumentSet(std::string_view name);
+	// Произвольное изменение копии писателя. change повторяется на второй копии сервера,
+	// поэтому должно давать одинаковый результат для одинаковых серверов и при исключении
+	// оставлять сервер неизменным
+	void Update(Change change);
+
+	// Публикует накопленные изменения. Читатели, взявшие снимок после вызова, видят их
+	void Publish();
+	// Сжимает индекс (SearchServer::Compact) вне пути записи: опубликованный сервер копируется
+	// и сжимается без блокировки писателя, затем копия догоняется изменениями, сделанными
+	// за это время, и становится копией писателя. Читатели видят сжатый сервер после
+	// следующего Publish. Вызывается из отдельного потока обслуживания, например когда
+	// NeedsCompaction снимка возвращает true. Одновременно выполняется одно сжатие
+	void Compact();
+
+private:
+	std::mutex writer_mutex_;
+	// Читается std::atomic_load и меняется std::atomic_store
+	std::shared_ptr<const SearchServer> snapshot_;
+	// Изменяемые указатели на опубликованную копию и на предыдущую, которой
+	// не хватает изменений standby_changes_
+	std::shared_ptr<SearchServer> published_;
+	std::shared_ptr<SearchServer> standby_;
+	std::vector<Change> standby_changes_;
+	// Копия писателя и изменения, которых нет в опубликованной копии
+	std::shared_ptr<SearchServer> writer_;
+	std::vector<Change> writer_changes_;
+	std::atomic<uint64_t> version_{0};
+	// Сжатия выполняются по одному
+	std::mutex compaction_mutex_;
+	// Пока идет сжатие, изменения запоминаются еще и для сжимаемой копии
+	bool is_compacting_ = false;
+	std::vector<Change> compaction_changes_;
+	// Копия писателя сжата, поэтому предыдущая версия после публикации не используется
+	// повторно: догнанная изменениями, она осталась бы несжатой
+	bool is_standby_stale_ = false;
+
+	// Применяет change к копии писателя и запоминает его. Вызывается под writer_mutex_
+	void Apply(Change change);
+	// Копия писателя: предыдущая копия, догнанная повторением изменений, если ее
+	// больше никто не читает, иначе копия опубликованной
+	SearchServer & GetWriter();
+};
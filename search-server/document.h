@@ -1,8 +1,13 @@
 #pragma once
 
+#include <cstdint>
 #include <string>
 #include <iostream>
 
+// Внутренний плотный номер документа. Номера выдаются по возрастанию в порядке добавления,
+// пропуски от удаленных документов убираются перенумерацией с сохранением порядка
+using DocumentOrdinal = uint32_t;
+
 enum class DocumentStatus {
 	ACTUAL,
 	IRRELEVANT,
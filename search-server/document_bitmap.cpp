@@ -0,0 +1,233 @@
+#include "document_bitmap.h"
+
+#include <algorithm>
+#include <iterator>
+
+bool DocumentBitmap::Container::Contains(uint16_t value) const {
+	if (IsDense()) {
+		return (bits[value / 64] >> (value % 64)) & 1;
+	}
+	return std::binary_search(values.begin(), values.end(), value);
+}
+
+void DocumentBitmap::Container::Normalize() {
+	if (!IsDense() && cardinality > ARRAY_LIMIT) {
+		bits.assign(WORD_COUNT, 0);
+		for (uint16_t value : values) {
+			bits[value / 64] |= uint64_t{1} << (value % 64);
+		}
+		values.clear();
+		values.shrink_to_fit();
+	} else if (IsDense() && cardinality <= ARRAY_LIMIT) {
+		values.clear();
+		values.reserve(cardinality);
+		for (size_t word_index = 0; word_index < WORD_COUNT; ++word_index) {
+			for (uint64_t word = bits[word_index]; word != 0; word &= word - 1) {
+				values.push_back(static_cast<uint16_t>(word_index * 64 + CountTrailingZeros(word)));
+			}
+		}
+		bits.clear();
+		bits.shrink_to_fit();
+	}
+}
+
+void DocumentBitmap::Add(DocumentOrdinal ordinal) {
+	const uint16_t key = static_cast<uint16_t>(ordinal >> 16);
+	const uint16_t value = static_cast<uint16_t>(ordinal & 0xFFFF);
+	auto it = std::lower_bound(containers_.begin(), containers_.end(), key,
+		[](const Container & container, uint16_t search_key) {
+			return container.key < search_key;
+		});
+	if (it == containers_.end() || it->key != key) {
+		it = containers_.insert(it, Container(key));
+	}
+	Container & container = *it;
+	if (container.IsDense()) {
+		uint64_t & word = container.bits[value / 64];
+		const uint64_t mask = uint64_t{1} << (value % 64);
+		if (word & mask) {
+			return;
+		}
+		word |= mask;
+	} else {
+		// Номера обычно добавляются по возрастанию, поэтому сначала проверяем конец массива
+		auto position = container.values.empty() || container.values.back() < value
+			? container.values.end()
+			: std::lower_bound(container.values.begin(), container.values.end(), value);
+		if (position != container.values.end() && *position == value) {
+			return;
+		}
+		container.values.insert(position, value);
+	}
+	++container.cardinality;
+	++cardinality_;
+	container.Normalize();
+}
+
+void DocumentBitmap::Remove(DocumentOrdinal ordinal) {
+	const uint16_t key = static_cast<uint16_t>(ordinal >> 16);
+	const uint16_t value = static_cast<uint16_t>(ordinal & 0xFFFF);
+	auto it = std::lower_bound(containers_.begin(), containers_.end(), key,
+		[](const Container & container, uint16_t search_key) {
+			return container.key < search_key;
+		});
+	if (it == containers_.end() || it->key != key || !it->Contains(value)) {
+		return;
+	}
+	if (it->IsDense()) {
+		it->bits[value / 64] &= ~(uint64_t{1} << (value % 64));
+	} else {
+		it->values.erase(std::lower_bound(it->values.begin(), it->values.end(), value));
+	}
+	--it->cardinality;
+	--cardinality_;
+	if (it->cardinality == 0) {
+		containers_.erase(it);
+	} else {
+		it->Normalize();
+	}
+}
+
+void DocumentBitmap::RemoveSorted(const std::vector<DocumentOrdinal> & ordinals) {
+	auto container_it = containers_.begin();
+	for (size_t first = 0; first < ordinals.size();) {
+		// Номера одного участка идут в массиве подряд
+		const uint16_t key = static_cast<uint16_t>(ordinals[first] >> 16);
+		size_t last = first;
+		while (last < ordinals.size() && static_cast<uint16_t>(ordinals[last] >> 16) == key) {
+			++last;
+		}
+		container_it = std::lower_bound(container_it, containers_.end(), key,
+			[](const Container & container, uint16_t search_key) {
+				return container.key < search_key;
+			});
+		if (container_it == containers_.end()) {
+			break;
+		}
+		if (container_it->key != key) {
+			first = last;
+			continue;
+		}
+		Container & container = *container_it;
+		uint32_t removed_count = 0;
+		if (container.IsDense()) {
+			for (size_t i = first; i < last; ++i) {
+				const uint16_t value = static_cast<uint16_t>(ordinals[i] & 0xFFFF);
+				uint64_t & word = container.bits[value / 64];
+				const uint64_t mask = uint64_t{1} << (value % 64);
+				removed_count += (word & mask) != 0;
+				word &= ~mask;
+			}
+		} else {
+			// Слияние двух упорядоченных последовательностей: оставшиеся значения сдвигаются к началу
+			size_t i = first;
+			auto output = container.values.begin();
+			for (const uint16_t value : container.values) {
+				while (i < last && static_cast<uint16_t>(ordinals[i] & 0xFFFF) < value) {
+					++i;
+				}
+				if (i < last && static_cast<uint16_t>(ordinals[i] & 0xFFFF) == value) {
+					continue;
+				}
+				*output++ = value;
+			}
+			removed_count = static_cast<uint32_t>(container.values.end() - output);
+			container.values.erase(output, container.values.end());
+		}
+		container.cardinality -= removed_count;
+		cardinality_ -= removed_count;
+		if (container.cardinality == 0) {
+			container_it = containers_.erase(container_it);
+		} else {
+			container.Normalize();
+			++container_it;
+		}
+		first = last;
+	}
+}
+
+bool DocumentBitmap::Contains(DocumentOrdinal ordinal) const {
+	const Container * container = FindContainer(static_cast<uint16_t>(ordinal >> 16));
+	return container && container->Contains(static_cast<uint16_t>(ordinal & 0xFFFF));
+}
+
+size_t DocumentBitmap::GetCardinality() const {
+	return cardinality_;
+}
+
+bool DocumentBitmap::IsEmpty() const {
+	return cardinality_ == 0;
+}
+
+size_t DocumentBitmap::GetMemoryUsage() const {
+	size_t result = containers_.capacity() * sizeof(Container);
+	for (const Container & container : containers_) {
+		result += container.values.capacity() * sizeof(uint16_t) + container.bits.capacity() * sizeof(uint64_t);
+	}
+	return result;
+}
+
+DocumentBitmap DocumentBitmap::Intersect(const DocumentBitmap & lhs, const DocumentBitmap & rhs) {
+	DocumentBitmap result;
+	auto lhs_it = lhs.containers_.begin();
+	auto rhs_it = rhs.containers_.begin();
+	while (lhs_it != lhs.containers_.end() && rhs_it != rhs.containers_.end()) {
+		if (lhs_it->key < rhs_it->key) {
+			++lhs_it;
+		} else if (rhs_it->key < lhs_it->key) {
+			++rhs_it;
+		} else {
+			Container container = Intersect(*lhs_it, *rhs_it);
+			if (container.cardinality > 0) {
+				result.cardinality_ += container.cardinality;
+				result.containers_.push_back(std::move(container));
+			}
+			++lhs_it;
+			++rhs_it;
+		}
+	}
+	return result;
+}
+
+void DocumentBitmap::Remap(const std::vector<DocumentOrdinal> & new_ordinals) {
+	DocumentBitmap remapped;
+	ForEach([&](DocumentOrdinal ordinal) {
+		remapped.Add(new_ordinals[ordinal]);
+	});
+	*this = std::move(remapped);
+}
+
+const DocumentBitmap::Container * DocumentBitmap::FindContainer(uint16_t key) const {
+	auto it = std::lower_bound(containers_.begin(), containers_.end(), key,
+		[](const Container & container, uint16_t search_key) {
+			return container.key < search_key;
+		});
+	return it != containers_.end() && it->key == key ? &*it : nullptr;
+}
+
+DocumentBitmap::Container DocumentBitmap::Intersect(const Container & lhs, const Container & rhs) {
+	Container result(lhs.key);
+	if (lhs.IsDense() && rhs.IsDense()) {
+		result.bits.resize(WORD_COUNT);
+		for (size_t i = 0; i < WORD_COUNT; ++i) {
+			result.bits[i] = lhs.bits[i] & rhs.bits[i];
+			result.cardinality += CountOnes(result.bits[i]);
+		}
+	} else if (!lhs.IsDense() && !rhs.IsDense()) {
+		std::set_intersection(lhs.values.begin(), lhs.values.end(), rhs.values.begin(), rhs.values.end(),
+			std::back_inserter(result.values));
+		result.cardinality = static_cast<uint32_t>(result.values.size());
+	} else {
+		// Массив проверяется по битовой карте
+		const Container & sparse = lhs.IsDense() ? rhs : lhs;
+		const Container & dense = lhs.IsDense() ? lhs : rhs;
+		for (uint16_t value : sparse.values) {
+			if (dense.Contains(value)) {
+				result.values.push_back(value);
+			}
+		}
+		result.cardinality = static_cast<uint32_t>(result.values.size());
+	}
+	result.Normalize();
+	return result;
+}
@@ -0,0 +1,101 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+#include "document.h"
+
+// Сжатое множество номеров документов в духе Roaring bitmap.
+// Номера делятся на участки по 65536 по старшим 16 битам. Разреженный участок хранит
+// упорядоченный массив младших 16 бит, плотный (больше ARRAY_LIMIT номеров) - битовую карту
+class DocumentBitmap {
+public:
+	static constexpr size_t ARRAY_LIMIT = 4096;
+
+	void Add(DocumentOrdinal ordinal);
+	void Remove(DocumentOrdinal ordinal);
+	// Удаляет номера из массива, упорядоченного по возрастанию, за один проход по участкам.
+	// Номера, которых нет в множестве, пропускаются
+	void RemoveSorted(const std::vector<DocumentOrdinal> & ordinals);
+	bool Contains(DocumentOrdinal ordinal) const;
+	size_t GetCardinality() const;
+	bool IsEmpty() const;
+	// Память, занятая множеством, в байтах
+	size_t GetMemoryUsage() const;
+
+	// Пересечение множеств. Участки сравниваются по ключам, плотные участки - словами по 64 бита
+	static DocumentBitmap Intersect(const DocumentBitmap & lhs, const DocumentBitmap & rhs);
+	// Заменяет номера документов на new_ordinals[номер]. Перенумерация должна сохранять порядок
+	void Remap(const std::vector<DocumentOrdinal> & new_ordinals);
+
+	// Вызывает function(ordinal) для номеров по возрастанию
+	template <typename Function>
+	void ForEach(Function function) const;
+
+private:
+	static constexpr size_t WORD_COUNT = 65536 / 64;
+
+	struct Container {
+		explicit Container(uint16_t container_key)
+			: key(container_key) {}
+
+		uint16_t key;
+		uint32_t cardinality = 0;
+		// Заполнено одно из двух представлений
+		std::vector<uint16_t> values;
+		std::vector<uint64_t> bits;
+
+		bool IsDense() const {
+			return !bits.empty();
+		}
+		bool Contains(uint16_t value) const;
+		// Переводит участок в представление, подходящее для его размера
+		void Normalize();
+	};
+
+	std::vector<Container> containers_;
+	size_t cardinality_ = 0;
+
+	const Container * FindContainer(uint16_t key) const;
+	static unsigned CountTrailingZeros(uint64_t word) {
+#if defined(__GNUC__) || defined(__clang__)
+		return static_cast<unsigned>(__builtin_ctzll(word));
+#else
+		unsigned count = 0;
+		for (; (word & 1) == 0; word >>= 1) {
+			++count;
+		}
+		return count;
+#endif
+	}
+	static unsigned CountOnes(uint64_t word) {
+#if defined(__GNUC__) || defined(__clang__)
+		return static_cast<unsigned>(__builtin_popcountll(word));
+#else
+		unsigned count = 0;
+		for (; word != 0; word &= word - 1) {
+			++count;
+		}
+		return count;
+#endif
+	}
+	static Container Intersect(const Container & lhs, const Container & rhs);
+};
+
+template <typename Function>
+void DocumentBitmap::ForEach(Function function) const {
+	for (const Container & container : containers_) {
+		const DocumentOrdinal high = static_cast<DocumentOrdinal>(container.key) << 16;
+		if (!container.IsDense()) {
+			for (uint16_t value : container.values) {
+				function(high | value);
+			}
+			continue;
+		}
+		for (size_t word_index = 0; word_index < WORD_COUNT; ++word_index) {
+			for (uint64_t word = container.bits[word_index]; word != 0; word &= word - 1) {
+				const DocumentOrdinal low = static_cast<DocumentOrdinal>(word_index * 64 + CountTrailingZeros(word));
+				function(high | low);
+			}
+		}
+	}
+}
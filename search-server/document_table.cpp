@@ -0,0 +1,84 @@
+#include "document_table.h"
+
+DocumentOrdinal DocumentTable::Add(int document_id, int rating, DocumentStatus status,
+	uint32_t length, Terms terms)
+{
+	const DocumentOrdinal ordinal = static_cast<DocumentOrdinal>(ids_.size());
+	ids_.push_back(document_id);
+	ratings_.push_back(rating);
+	statuses_.push_back(status);
+	lengths_.push_back(length);
+	terms_.push_back(std::move(terms));
+	id_to_ordinal_.emplace(document_id, ordinal);
+	return ordinal;
+}
+
+void DocumentTable::Remove(DocumentOrdinal ordinal) {
+	id_to_ordinal_.erase(ids_[ordinal]);
+	ids_[ordinal] = -1;
+	// Прямой индекс освобождается сразу, остальные поля занимают несколько байт
+	Terms().swap(terms_[ordinal]);
+	++removed_count_;
+}
+
+bool DocumentTable::Contains(int document_id) const {
+	return id_to_ordinal_.count(document_id) > 0;
+}
+
+std::optional<DocumentOrdinal> DocumentTable::FindOrdinal(int document_id) const {
+	if (auto it = id_to_ordinal_.find(document_id); it != id_to_ordinal_.end()) {
+		return it->second;
+	}
+	return std::nullopt;
+}
+
+DocumentOrdinal DocumentTable::GetOrdinal(int document_id) const {
+	return id_to_ordinal_.at(document_id);
+}
+
+size_t DocumentTable::GetDocumentCount() const {
+	return id_to_ordinal_.size();
+}
+
+size_t DocumentTable::GetOrdinalCount() const {
+	return ids_.size();
+}
+
+size_t DocumentTable::GetRemovedCount() const {
+	return removed_count_;
+}
+
+std::vector<DocumentOrdinal> DocumentTable::Compact() {
+	std::vector<DocumentOrdinal> new_ordinals(ids_.size(), PostingList::NO_ORDINAL);
+	DocumentOrdinal next_ordinal = 0;
+	for (size_t ordinal = 0; ordinal < ids_.size(); ++ordinal) {
+		if (ids_[ordinal] < 0) {
+			continue;
+		}
+		new_ordinals[ordinal] = next_ordinal;
+		ids_[next_ordinal] = ids_[ordinal];
+		ratings_[next_ordinal] = ratings_[ordinal];
+		statuses_[next_ordinal] = statuses_[ordinal];
+		lengths_[next_ordinal] = lengths_[ordinal];
+		if (next_ordinal != ordinal) {
+			terms_[next_ordinal] = std::move(terms_[ordinal]);
+		}
+		id_to_ordinal_[ids_[next_ordinal]] = next_ordinal;
+		++next_ordinal;
+	}
+	ids_.resize(next_ordinal);
+	ratings_.resize(next_ordinal);
+	statuses_.resize(next_ordinal);
+	lengths_.resize(next_ordinal);
+	terms_.resize(next_ordinal);
+	removed_count_ = 0;
+	return new_ordinals;
+}
+
+void DocumentTable::RemapTerms(const std::vector<InvertedIndex::TermId> & new_term_ids) {
+	for (Terms & terms : terms_) {
+		for (InvertedIndex::TermFrequency & term : terms) {
+			term.term_id = new_term_ids[term.term_id];
+		}
+	}
+}
@@ -0,0 +1,68 @@
+#pragma once
+
+#include <cstdint>
+#include <optional>
+#include <unordered_map>
+#include <vector>
+#include "document.h"
+#include "inverted_index.h"
+
+// Данные документов, разложенные по массивам с индексом - номером документа:
+// id, рейтинг, статус, длина (число слов без стоп-слов) и прямой индекс.
+// Поиск читает поля подряд по номерам, а id переводится в номер хеш-таблицей.
+// Номер удаленного документа остается занятым (с id -1) до перенумерации
+class DocumentTable {
+public:
+	using Terms = std::vector<InvertedIndex::TermFrequency>;
+
+	// Добавляет документ под следующим номером
+	DocumentOrdinal Add(int document_id, int rating, DocumentStatus status, uint32_t length, Terms terms);
+	// Освобождает номер документа. Массивы не сжимаются до Compact
+	void Remove(DocumentOrdinal ordinal);
+
+	bool Contains(int document_id) const;
+	std::optional<DocumentOrdinal> FindOrdinal(int document_id) const;
+	// Номер документа. Для отсутствующего id выбрасывает std::out_of_range
+	DocumentOrdinal GetOrdinal(int document_id) const;
+
+	int GetId(DocumentOrdinal ordinal) const {
+		return ids_[ordinal];
+	}
+	int GetRating(DocumentOrdinal ordinal) const {
+		return ratings_[ordinal];
+	}
+	DocumentStatus GetStatus(DocumentOrdinal ordinal) const {
+		return statuses_[ordinal];
+	}
+	uint32_t GetLength(DocumentOrdinal ordinal) const {
+		return lengths_[ordinal];
+	}
+	// Слова документа, упорядоченные по id слова
+	const Terms & GetTerms(DocumentOrdinal ordinal) const {
+		return terms_[ordinal];
+	}
+	Terms & GetTerms(DocumentOrdinal ordinal) {
+		return terms_[ordinal];
+	}
+
+	// Число живых документов
+	size_t GetDocumentCount() const;
+	// Число выданных номеров, включая номера удаленных документов
+	size_t GetOrdinalCount() const;
+	size_t GetRemovedCount() const;
+
+	// Перенумеровывает документы подряд с сохранением порядка. Возвращает новые номера
+	// по старым, для удаленных документов - PostingList::NO_ORDINAL
+	std::vector<DocumentOrdinal> Compact();
+	// Заменяет id слов в прямом индексе на new_term_ids[id]. Замена должна сохранять порядок id
+	void RemapTerms(const std::vector<InvertedIndex::TermId> & new_term_ids);
+
+private:
+	std::vector<int> ids_;
+	std::vector<int> ratings_;
+	std::vector<DocumentStatus> statuses_;
+	std::vector<uint32_t> lengths_;
+	std::vector<Terms> terms_;
+	std::unordered_map<int, DocumentOrdinal> id_to_ordinal_;
+	size_t removed_count_ = 0;
+};
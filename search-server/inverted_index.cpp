@@ -0,0 +1,179 @@
+#include "inverted_index.h"
+
+#include <algorithm>
+#include <cmath>
+
+InvertedIndex::TermId InvertedIndex::AddTerm(std::string_view word) {
+	if (auto it = term_ids_.find(word); it != term_ids_.end()) {
+		return it->second;
+	}
+	TermId term_id = static_cast<TermId>(terms_.size());
+	// Строки хранилища не перемещаются, поэтому ключи term_ids_ остаются валидными
+	terms_.push_back(term_storage_.Store(word));
+	term_ids_.emplace(terms_.back(), term_id);
+	postings_.emplace_back();
+	removed_counts_.push_back(0);
+	idf_cache_.emplace_back();
+	return term_id;
+}
+
+std::optional<InvertedIndex::TermId> InvertedIndex::FindTerm(std::string_view word) const {
+	if (auto it = term_ids_.find(word); it != term_ids_.end()) {
+		return it->second;
+	}
+	return std::nullopt;
+}
+
+std::string_view InvertedIndex::GetTerm(TermId term_id) const {
+	return terms_.at(term_id);
+}
+
+size_t InvertedIndex::GetTermCount() const {
+	return terms_.size();
+}
+
+size_t InvertedIndex::GetEmptyTermCount() const {
+	return static_cast<size_t>(std::count_if(postings_.begin(), postings_.end(),
+		[](const PostingList & postings) {
+			return postings.IsEmpty();
+		}));
+}
+
+std::vector<InvertedIndex::TermId> InvertedIndex::PurgeEmptyTerms() {
+	std::vector<TermId> new_term_ids(terms_.size(), NO_TERM);
+	const size_t term_count = terms_.size() - GetEmptyTermCount();
+	StringArena term_storage;
+	std::vector<std::string_view> terms;
+	std::unordered_map<std::string_view, TermId> term_ids;
+	std::vector<PostingList> postings;
+	std::vector<uint32_t> removed_counts;
+	std::vector<IdfCacheEntry> idf_cache;
+	terms.reserve(term_count);
+	term_ids.reserve(term_count);
+	postings.reserve(term_count);
+	removed_counts.reserve(term_count);
+	idf_cache.reserve(term_count);
+	for (TermId term_id = 0; term_id < terms_.size(); ++term_id) {
+		if (postings_[term_id].IsEmpty()) {
+			continue;
+		}
+		new_term_ids[term_id] = static_cast<TermId>(terms.size());
+		terms.push_back(term_storage.Store(terms_[term_id]));
+		term_ids.emplace(terms.back(), new_term_ids[term_id]);
+		postings.push_back(std::move(postings_[term_id]));
+		removed_counts.push_back(removed_counts_[term_id]);
+		// Число документов со словом не меняется, поэтому idf остается действительным
+		idf_cache.push_back(idf_cache_[term_id]);
+	}
+	term_storage_ = std::move(term_storage);
+	terms_ = std::move(terms);
+	term_ids_ = std::move(term_ids);
+	postings_ = std::move(postings);
+	removed_counts_ = std::move(removed_counts);
+	idf_cache_ = std::move(idf_cache);
+	return new_term_ids;
+}
+
+const PostingList & InvertedIndex::GetPostings(TermId term_id) const {
+	return postings_.at(term_id);
+}
+
+PostingList::Cursor InvertedIndex::GetCursor(TermId term_id,
+	DocumentOrdinal first_ordinal, DocumentOrdinal last_ordinal) const
+{
+	return PostingList::Cursor(postings_.at(term_id), first_ordinal, last_ordinal);
+}
+
+double InvertedIndex::GetMaxTf(TermId term_id) const {
+	return postings_.at(term_id).GetMaxTf();
+}
+
+void InvertedIndex::AddPosting(TermId term_id, DocumentOrdinal ordinal, double tf) {
+	postings_.at(term_id).Add(ordinal, tf);
+}
+
+void InvertedIndex::AppendPostings(const std::vector<TermPosting> & term_postings) {
+	std::vector<size_t> new_posting_counts(postings_.size(), 0);
+	for (const TermPosting & term_posting : term_postings) {
+		++new_posting_counts[term_posting.term_id];
+	}
+	for (TermId term_id = 0; term_id < postings_.size(); ++term_id) {
+		postings_[term_id].Reserve(new_posting_counts[term_id]);
+	}
+	for (const TermPosting & term_posting : term_postings) {
+		AddPosting(term_posting.term_id, term_posting.posting.ordinal, term_posting.posting.tf);
+	}
+}
+
+void InvertedIndex::AssignPostings(TermId term_id, const Posting * first, const Posting * last) {
+	postings_.at(term_id).Assign(first, last);
+	removed_counts_[term_id] = 0;
+}
+
+void InvertedIndex::AssignPostings(TermId term_id, PostingList postings) {
+	postings_.at(term_id) = std::move(postings);
+	removed_counts_[term_id] = 0;
+}
+
+void InvertedIndex::RemovePosting(TermId term_id, DocumentOrdinal ordinal) {
+	postings_.at(term_id).Remove(ordinal);
+}
+
+bool InvertedIndex::HasPosting(TermId term_id, DocumentOrdinal ordinal) const {
+	return postings_.at(term_id).Contains(ordinal);
+}
+
+bool InvertedIndex::MarkPostingRemoved(TermId term_id) {
+	const size_t removed_count = ++removed_counts_.at(term_id);
+	const size_t size = postings_[term_id].GetSize();
+	// true только при переходе через половину, чтобы пакетное удаление не очищало список дважды
+	return removed_count * 2 > size && (removed_count - 1) * 2 <= size;
+}
+
+size_t InvertedIndex::GetDocumentFrequency(TermId term_id) const {
+	return postings_.at(term_id).GetSize() - removed_counts_[term_id];
+}
+
+void InvertedIndex::RemapOrdinals(const std::vector<DocumentOrdinal> & new_ordinals) {
+	// Номера до первого удаленного документа не меняются, и вхождений удаленных среди них нет
+	DocumentOrdinal first_changed = 0;
+	while (first_changed < new_ordinals.size() && new_ordinals[first_changed] == first_changed) {
+		++first_changed;
+	}
+	for (TermId term_id = 0; term_id < postings_.size(); ++term_id) {
+		PostingList & postings = postings_[term_id];
+		if (postings.IsEmpty() || postings.GetLastOrdinal() < first_changed) {
+			continue;
+		}
+		postings.Remap(new_ordinals);
+		removed_counts_[term_id] = 0;
+	}
+}
+
+void InvertedIndex::SetDocumentCount(size_t document_count) {
+	document_count_ = document_count;
+	++epoch_;
+}
+
+double InvertedIndex::GetIdf(TermId term_id) const {
+	IdfCacheEntry & entry = idf_cache_.at(term_id);
+	if (entry.epoch.load(std::memory_order_acquire) == epoch_) {
+		return entry.idf.load(std::memory_order_relaxed);
+	}
+	const double idf = std::log(static_cast<double>(document_count_)
+		/ static_cast<double>(GetDocumentFrequency(term_id)));
+	entry.idf.store(idf, std::memory_order_relaxed);
+	entry.epoch.store(epoch_, std::memory_order_release);
+	return idf;
+}
+
+InvertedIndex::IdfCacheEntry::IdfCacheEntry(const IdfCacheEntry & other)
+	: epoch(other.epoch.load(std::memory_order_acquire))
+	, idf(other.idf.load(std::memory_order_relaxed))
+{}
+
+InvertedIndex::IdfCacheEntry & InvertedIndex::IdfCacheEntry::operator=(const IdfCacheEntry & other) {
+	epoch.store(other.epoch.load(std::memory_order_acquire), std::memory_order_relaxed);
+	idf.store(other.idf.load(std::memory_order_relaxed), std::memory_order_relaxed);
+	return *this;
+}
@@ -0,0 +1,132 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <limits>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+#include "document.h"
+#include "posting_list.h"
+#include "string_arena.h"
+
+// Инвертированный индекс: словарь терминов и списки вхождений.
+// Каждое слово получает плотный id, по которому хранится сжатый список
+// пар (номер документа, tf), упорядоченный по номеру документа.
+// Номер документа - внутренний плотный id, выдаваемый по порядку добавления
+class InvertedIndex {
+public:
+	using TermId = uint32_t;
+	static constexpr TermId NO_TERM = std::numeric_limits<TermId>::max();
+
+	using Posting = PostingList::Posting;
+
+	// Элемент прямого индекса: слово документа и его tf
+	struct TermFrequency {
+		TermId term_id;
+		double tf;
+	};
+
+	struct TermPosting {
+		TermId term_id;
+		Posting posting;
+	};
+
+	// Возвращает id слова, при необходимости добавляя его в словарь
+	TermId AddTerm(std::string_view word);
+	// Возвращает id слова или пустое значение, если слова нет в словаре
+	std::optional<TermId> FindTerm(std::string_view word) const;
+	// Возвращает слово по его id. Строка принадлежит словарю и не меняет адрес
+	std::string_view GetTerm(TermId term_id) const;
+	size_t GetTermCount() const;
+	// Число слов словаря с пустыми списками вхождений
+	size_t GetEmptyTermCount() const;
+	// Выбрасывает из словаря слова с пустыми списками вхождений и перестраивает хранилище строк
+	// из оставшихся. Оставшиеся слова получают id подряд с сохранением порядка. Возвращает
+	// новые id по старым, для выброшенных слов - NO_TERM. Ранее полученные строки слов
+	// становятся недействительными
+	std::vector<TermId> PurgeEmptyTerms();
+
+	const PostingList & GetPostings(TermId term_id) const;
+	// Курсор по вхождениям документов с номерами из [first_ordinal, last_ordinal)
+	PostingList::Cursor GetCursor(TermId term_id, DocumentOrdinal first_ordinal, DocumentOrdinal last_ordinal) const;
+	// Наибольший tf слова среди документов. Вместе с idf дает верхнюю границу вклада слова
+	double GetMaxTf(TermId term_id) const;
+	// Добавляет к tf документа значение tf, сохраняя порядок по номеру документа.
+	// tf хранится с точностью float, см. PostingList::QuantizeTf
+	void AddPosting(TermId term_id, DocumentOrdinal ordinal, double tf);
+	// Добавляет вхождения пакета документов. Для каждого слова сначала подсчитывается число
+	// новых вхождений, чтобы выделить память под таблицу блоков один раз
+	void AppendPostings(const std::vector<TermPosting> & term_postings);
+	// Заменяет список вхождений слова массивом [first, last), упорядоченным по номеру документа
+	void AssignPostings(TermId term_id, const Posting * first, const Posting * last);
+	// Заменяет список вхождений слова готовым сжатым списком
+	void AssignPostings(TermId term_id, PostingList postings);
+	void RemovePosting(TermId term_id, DocumentOrdinal ordinal);
+	bool HasPosting(TermId term_id, DocumentOrdinal ordinal) const;
+	// Учитывает удаление документа со словом, не трогая список вхождений: вхождение остается
+	// в списке до очистки или перенумерации, но документ больше не считается в числе документов
+	// со словом. Поиск должен сам пропускать такие документы. Возвращает true, когда помеченных
+	// вхождений слова стало больше живых: тогда список стоит очистить PurgeRemovedPostings,
+	// и цена очистки делится между удалениями. Вызовы для разных слов можно
+	// выполнять параллельно
+	bool MarkPostingRemoved(TermId term_id);
+	// Выбрасывает из списка слова вхождения документов, для номеров которых is_live возвращает
+	// false. Номера документов не меняются, поэтому остальные списки не затрагиваются.
+	// Вызовы для разных слов можно выполнять параллельно
+	template <typename Predicate>
+	void PurgeRemovedPostings(TermId term_id, Predicate is_live);
+	// Число документов со словом без помеченных удаленными
+	size_t GetDocumentFrequency(TermId term_id) const;
+
+	// Заменяет номера документов на new_ordinals[номер]. Перенумерация должна сохранять
+	// порядок номеров, а помеченные удаленными вхождения должны получить PostingList::NO_ORDINAL.
+	// Списки, все номера которых меньше первого измененного, не перестраиваются
+	void RemapOrdinals(const std::vector<DocumentOrdinal> & new_ordinals);
+
+	// Сообщает индексу число документов после любого изменения их набора.
+	// Начинает новую эпоху, в которой все сохраненные значения idf недействительны
+	void SetDocumentCount(size_t document_count);
+	// idf слова: log(число документов / число документов со словом). Вычисляется при первом
+	// обращении в эпохе, дальше читается из кэша. Слово должно встречаться хотя бы в одном документе.
+	// Можно вызывать из нескольких потоков одновременно
+	double GetIdf(TermId term_id) const;
+
+private:
+	// Значение idf и эпоха, в которой оно вычислено. Эпоха 0 - значения нет.
+	// Одновременные вычисления в одной эпохе записывают одно и то же значение
+	struct IdfCacheEntry {
+		std::atomic<uint64_t> epoch{0};
+		std::atomic<double> idf{0.0};
+
+		IdfCacheEntry() = default;
+		IdfCacheEntry(const IdfCacheEntry & other);
+		IdfCacheEntry & operator=(const IdfCacheEntry & other);
+	};
+
+	StringArena term_storage_;
+	std::vector<std::string_view> terms_;
+	std::unordered_map<std::string_view, TermId> term_ids_;
+	std::vector<PostingList> postings_;
+	// Число помеченных удаленными вхождений каждого слова
+	std::vector<uint32_t> removed_counts_;
+	// Кэш заполняется из константных запросов
+	mutable std::vector<IdfCacheEntry> idf_cache_;
+	size_t document_count_ = 0;
+	uint64_t epoch_ = 1;
+};
+
+template <typename Predicate>
+void InvertedIndex::PurgeRemovedPostings(TermId term_id, Predicate is_live) {
+	std::vector<Posting> postings;
+	postings.reserve(GetDocumentFrequency(term_id));
+	postings_.at(term_id).ForEach(0, PostingList::NO_ORDINAL,
+		[&postings, &is_live](DocumentOrdinal ordinal, double tf) {
+			if (is_live(ordinal)) {
+				postings.push_back({ordinal, tf});
+			}
+		});
+	AssignPostings(term_id, postings.data(), postings.data() + postings.size());
+}
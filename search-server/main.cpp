@@ -16,6 +16,10 @@
 #include "test_paginator.h"
 #include "test_request_queue.h"
 #include "test_remove_duplicates.h"
+#include "test_inverted_index.h"
+#include "test_thread_pool.h"
+#include "test_process_queries.h"
+#include "test_concurrent_search_server.h"
 
 using std::literals::string_literals::operator""s;
 
@@ -25,6 +29,10 @@ int main() {
 	TestPaginator();
 	TestRequestQueue();
 	TestRemoveDuplicates();
+	TestInvertedIndex();
+	TestThreadPool();
+	TestProcessQueries();
+	TestConcurrentSearchServer();
 
 	//Постраничная выдача
 	{
@@ -122,7 +130,9 @@ int main() {
 		AddDocument(search_server, 9, "nasty rat with curly hair"s, DocumentStatus::ACTUAL, {1, 2});
 
 		std::cout << "Before duplicates removed: "s << search_server.GetDocumentCount() << std::endl;
-		RemoveDuplicates(search_server);
+		for (const int document_id : RemoveDuplicates(search_server)) {
+			std::cout << "Found duplicate document id "s << document_id << std::endl;
+		}
 		std::cout << "After duplicates removed: "s << search_server.GetDocumentCount() << std::endl;
 	}
 
@@ -302,6 +312,17 @@ int main() {
 		const auto queries = GenerateQueries(generator, dictionary, 2'000, 7);
 		std::cerr << "ProcessQueries"s << std::endl;
 		TEST_TIME_QUERIES_PROCESSOR(ProcessQueries);
+		TEST_TIME_QUERIES_PROCESSOR(ProcessQueriesJoined);
+		TEST_TIME_QUERIES_PROCESSOR(ProcessQueriesFlat);
+	}
+	{
+		std::mt19937 generator;
+		const auto dictionary = GenerateDictionary(generator, 10'000, 25);
+		const auto documents = GenerateQueries(generator, dictionary, 50'000, 100);
+		std::cerr << "AddDocuments"s << std::endl;
+		TEST_DOCUMENTS_LOADING(AddDocument, false);
+		TEST_DOCUMENTS_LOADING(AddDocuments, true);
+		TEST_SNAPSHOT_LOADING();
 	}
 	{
 		std::mt19937 generator;
@@ -326,6 +347,27 @@ int main() {
 			TEST_MULTI_THREAD_REMOVING(par);
 		}
 	}
+	{
+		// Удаление 10% документов из индекса побольше, с несколькими статусами и множествами
+		std::mt19937 generator;
+		const auto dictionary = GenerateDictionary(generator, 10'000, 10);
+		const auto documents = GenerateQueriesStrict(generator, dictionary, 200'000, 30);
+		std::vector<DocumentRecord> records;
+		records.reserve(documents.size());
+		for (size_t i = 0; i < documents.size(); ++i) {
+			records.push_back({static_cast<int>(i), documents[i],
+				i % 3 == 0 ? DocumentStatus::BANNED : DocumentStatus::ACTUAL, {1, 2, 3}});
+		}
+		SearchServer search_server(dictionary[0]);
+		search_server.AddDocuments(records);
+		std::vector<int> even_ids;
+		for (int id = 0; id < static_cast<int>(documents.size()); id += 2) {
+			even_ids.push_back(id);
+		}
+		search_server.SetDocumentSet("even"s, even_ids);
+		TEST_BATCH_REMOVING(RemoveDocument, false);
+		TEST_BATCH_REMOVING(RemoveDocuments, true);
+	}
 	{
 		std::mt19937 generator;
 
@@ -354,6 +396,22 @@ int main() {
 		std::cerr << "FindTopDocuments"s << std::endl;
 		TEST_MULTI_THREAD_FINDING(seq);
 		TEST_MULTI_THREAD_FINDING(par);
+		TEST_MULTI_THREAD_FINDING_STRATEGY(seq, MAX_SCORE);
+	}
+	{
+		// Частоты слов по закону Ципфа: границы вкладов частых и редких слов сильно различаются,
+		// и MAX_SCORE пропускает большую часть вхождений частых слов
+		std::mt19937 generator;
+		const auto dictionary = GenerateDictionary(generator, 20'000, 10);
+		const auto documents = GenerateQueriesZipf(generator, dictionary, 20'000, 100);
+		SearchServer search_server(dictionary[0]);
+		for (size_t i = 0; i < documents.size(); ++i) {
+			search_server.AddDocument(i, documents[i], DocumentStatus::ACTUAL, {1, 2, 3});
+		}
+		const auto queries = GenerateQueriesZipf(generator, dictionary, 200, 5);
+		std::cerr << "FindTopDocuments (Zipf)"s << std::endl;
+		TEST_MULTI_THREAD_FINDING(seq);
+		TEST_MULTI_THREAD_FINDING_STRATEGY(seq, MAX_SCORE);
 	}
 	return 0;
 }
@@ -0,0 +1,679 @@
+#include "posting_list.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <stdexcept>
+#include "snapshot.h"
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+#if defined(__GNUC__) && defined(__x86_64__)
+#include <immintrin.h>
+#define POSTING_LIST_AVX2
+#endif
+
+namespace {
+
+uint8_t GetBitWidth(uint32_t value) {
+	uint8_t bits = 0;
+	while (value != 0) {
+		++bits;
+		value >>= 1;
+	}
+	return bits;
+}
+
+size_t GetPackedSize(uint8_t bits, size_t count) {
+	return (bits * count + 7) / 8;
+}
+
+// Дописывает count чисел шириной bits бит в конец data
+void PackBits(const uint32_t * values, uint8_t bits, size_t count, std::vector<uint8_t> & data) {
+	const size_t offset = data.size();
+	data.resize(offset + GetPackedSize(bits, count));
+	uint8_t * output = data.data() + offset;
+	uint64_t buffer = 0;
+	uint8_t buffered = 0;
+	for (size_t i = 0; i < count; ++i) {
+		buffer |= static_cast<uint64_t>(values[i]) << buffered;
+		buffered += bits;
+		while (buffered >= 8) {
+			*output++ = static_cast<uint8_t>(buffer);
+			buffer >>= 8;
+			buffered -= 8;
+		}
+	}
+	if (buffered > 0) {
+		*output = static_cast<uint8_t>(buffer);
+	}
+}
+
+#ifdef __SSE2__
+// Префиксная сумма четырех 32-битных разностей, продолженная с carry.
+// Возвращает последний номер четверки, размноженный на все четыре позиции
+__m128i PrefixSum(__m128i deltas, __m128i carry, DocumentOrdinal * ordinals) {
+	deltas = _mm_add_epi32(deltas, _mm_slli_si128(deltas, 4));
+	deltas = _mm_add_epi32(deltas, _mm_slli_si128(deltas, 8));
+	deltas = _mm_add_epi32(deltas, carry);
+	_mm_storeu_si128(reinterpret_cast<__m128i *>(ordinals), deltas);
+	return _mm_shuffle_epi32(deltas, 0xFF);
+}
+#endif
+
+#ifdef POSTING_LIST_AVX2
+bool HasAvx2() {
+	static const bool has_avx2 = __builtin_cpu_supports("avx2");
+	return has_avx2;
+}
+
+// Восемь чисел за раз: каждое читается 32-битной загрузкой со своего байта и сдвигается
+// на остаток позиции. Число помещается в загрузку при ширине не больше 25 бит
+constexpr uint8_t AVX2_MAX_BITS = 25;
+
+__attribute__((target("avx2")))
+size_t UnpackBitsAvx2(const uint8_t * packed, uint8_t bits, size_t count, uint32_t * values) {
+	const __m256i lanes = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+	const __m256i mask = _mm256_set1_epi32(static_cast<int>((uint32_t{1} << bits) - 1));
+	const __m256i step = _mm256_set1_epi32(8 * bits);
+	__m256i positions = _mm256_mullo_epi32(lanes, _mm256_set1_epi32(bits));
+	size_t i = 0;
+	for (; i + 8 <= count; i += 8) {
+		const __m256i words = _mm256_i32gather_epi32(reinterpret_cast<const int *>(packed),
+			_mm256_srli_epi32(positions, 3), 1);
+		const __m256i shifted = _mm256_srlv_epi32(words, _mm256_and_si256(positions, _mm256_set1_epi32(7)));
+		_mm256_storeu_si256(reinterpret_cast<__m256i *>(values + i), _mm256_and_si256(shifted, mask));
+		positions = _mm256_add_epi32(positions, step);
+	}
+	return i;
+}
+
+// Префиксная сумма восьми разностей: сначала внутри половин регистра, затем итог нижней
+// половины добавляется к верхней. Возвращает последний номер, размноженный на все позиции
+__attribute__((target("avx2")))
+__m256i PrefixSumAvx2(__m256i deltas, __m256i carry, DocumentOrdinal * ordinals) {
+	deltas = _mm256_add_epi32(deltas, _mm256_slli_si256(deltas, 4));
+	deltas = _mm256_add_epi32(deltas, _mm256_slli_si256(deltas, 8));
+	const __m256i low_total = _mm256_permutevar8x32_epi32(deltas, _mm256_set1_epi32(3));
+	deltas = _mm256_add_epi32(deltas, _mm256_blend_epi32(_mm256_setzero_si256(), low_total, 0xF0));
+	deltas = _mm256_add_epi32(deltas, carry);
+	_mm256_storeu_si256(reinterpret_cast<__m256i *>(ordinals), deltas);
+	return _mm256_permutevar8x32_epi32(deltas, _mm256_set1_epi32(7));
+}
+
+__attribute__((target("avx2")))
+size_t PrefixSumsAvx2(const uint32_t * deltas, size_t count, DocumentOrdinal base, DocumentOrdinal * ordinals) {
+	__m256i carry = _mm256_set1_epi32(static_cast<int>(base));
+	size_t i = 0;
+	for (; i + 8 <= count; i += 8) {
+		carry = PrefixSumAvx2(_mm256_loadu_si256(reinterpret_cast<const __m256i *>(deltas + i)), carry, ordinals + i);
+	}
+	return i;
+}
+#endif
+
+// Дописывает префиксные суммы deltas[from, count) к уже посчитанным ordinals[0, from)
+void PrefixSumsScalar(const uint32_t * deltas, size_t from, size_t count,
+	DocumentOrdinal base, DocumentOrdinal * ordinals)
+{
+	DocumentOrdinal ordinal = from == 0 ? base : ordinals[from - 1];
+	for (size_t i = from; i < count; ++i) {
+		ordinal += deltas[i];
+		ordinals[i] = ordinal;
+	}
+}
+
+} // namespace
+
+void UnpackBitsScalar(const uint8_t * packed, uint8_t bits, size_t count, uint32_t * values) {
+	if (bits == 0) {
+		std::fill(values, values + count, 0u);
+		return;
+	}
+	const uint64_t mask = (uint64_t{1} << bits) - 1;
+	for (size_t i = 0; i < count; ++i) {
+		const size_t position = i * bits;
+		uint64_t word;
+		std::memcpy(&word, packed + position / 8, sizeof(word));
+		values[i] = static_cast<uint32_t>((word >> (position % 8)) & mask);
+	}
+}
+
+void UnpackBits(const uint8_t * packed, uint8_t bits, size_t count, uint32_t * values) {
+#ifdef POSTING_LIST_AVX2
+	if (bits > 0 && bits <= AVX2_MAX_BITS && HasAvx2()) {
+		const size_t unpacked = UnpackBitsAvx2(packed, bits, count, values);
+		// Хвост распаковывается скалярно с позиции, кратной 8 числам, то есть целому байту
+		UnpackBitsScalar(packed + unpacked * bits / 8, bits, count - unpacked, values + unpacked);
+		return;
+	}
+#endif
+	UnpackBitsScalar(packed, bits, count, values);
+}
+
+void DecodeOrdinalsScalar(const uint8_t * packed, uint8_t bits, size_t count,
+	DocumentOrdinal base, DocumentOrdinal * ordinals)
+{
+	uint32_t deltas[PostingList::BLOCK_SIZE];
+	for (size_t first = 0; first < count; first += PostingList::BLOCK_SIZE) {
+		const size_t chunk = std::min(count - first, PostingList::BLOCK_SIZE);
+		UnpackBitsScalar(packed + first * bits / 8, bits, chunk, deltas);
+		PrefixSumsScalar(deltas, 0, chunk, first == 0 ? base : ordinals[first - 1], ordinals + first);
+	}
+}
+
+void DecodeOrdinals(const uint8_t * packed, uint8_t bits, size_t count,
+	DocumentOrdinal base, DocumentOrdinal * ordinals)
+{
+	uint32_t deltas[PostingList::BLOCK_SIZE];
+	for (size_t first = 0; first < count; first += PostingList::BLOCK_SIZE) {
+		const size_t chunk = std::min(count - first, PostingList::BLOCK_SIZE);
+		const DocumentOrdinal chunk_base = first == 0 ? base : ordinals[first - 1];
+		DocumentOrdinal * chunk_ordinals = ordinals + first;
+		UnpackBits(packed + first * bits / 8, bits, chunk, deltas);
+		size_t i = 0;
+#ifdef POSTING_LIST_AVX2
+		if (HasAvx2()) {
+			i = PrefixSumsAvx2(deltas, chunk, chunk_base, chunk_ordinals);
+		}
+#endif
+#ifdef __SSE2__
+		if (i == 0) {
+			__m128i carry = _mm_set1_epi32(static_cast<int>(chunk_base));
+			for (; i + 4 <= chunk; i += 4) {
+				carry = PrefixSum(_mm_loadu_si128(reinterpret_cast<const __m128i *>(deltas + i)),
+					carry, chunk_ordinals + i);
+			}
+		}
+#endif
+		PrefixSumsScalar(deltas, i, chunk, chunk_base, chunk_ordinals);
+	}
+}
+
+PostingList::Cursor::Cursor(const PostingList & postings,
+	DocumentOrdinal first_ordinal, DocumentOrdinal last_ordinal)
+	: postings_(&postings)
+	, last_ordinal_(last_ordinal)
+{
+	LoadBlock(postings.FindBlock(first_ordinal), first_ordinal);
+}
+
+void PostingList::Cursor::SkipTo(DocumentOrdinal ordinal) {
+	if (IsEnd() || ordinal <= ordinal_) {
+		return;
+	}
+	// Внутри загруженного блока ищем в буфере, иначе перепрыгиваем блоки по заголовкам
+	if (ordinals_[count_ - 1] >= ordinal) {
+		position_ = std::lower_bound(ordinals_.begin() + position_, ordinals_.begin() + count_, ordinal)
+			- ordinals_.begin();
+		UpdateOrdinal();
+		return;
+	}
+	const auto & blocks = postings_->blocks_;
+	if (block_index_ >= blocks.size()) {
+		ordinal_ = NO_ORDINAL;
+		return;
+	}
+	auto it = std::lower_bound(blocks.begin() + block_index_ + 1, blocks.end(), ordinal,
+		[](const Block & block, DocumentOrdinal value) {
+			return block.last_ordinal < value;
+		});
+	LoadBlock(static_cast<size_t>(it - blocks.begin()), ordinal);
+}
+
+void PostingList::Cursor::LoadBlock(size_t block_index, DocumentOrdinal ordinal) {
+	block_index_ = block_index;
+	if (block_index < postings_->blocks_.size()) {
+		count_ = postings_->DecodeBlock(postings_->blocks_[block_index], ordinals_.data(), tfs_.data());
+	} else {
+		const std::vector<Posting> & tail = postings_->tail_;
+		count_ = tail.size();
+		for (size_t i = 0; i < count_; ++i) {
+			ordinals_[i] = tail[i].ordinal;
+			tfs_[i] = static_cast<float>(tail[i].tf);
+		}
+	}
+	position_ = std::lower_bound(ordinals_.begin(), ordinals_.begin() + count_, ordinal) - ordinals_.begin();
+	UpdateOrdinal();
+}
+
+double PostingList::QuantizeTf(double tf) {
+	return static_cast<double>(static_cast<float>(tf));
+}
+
+size_t PostingList::GetSize() const {
+	return size_;
+}
+
+size_t PostingList::CountInRange(DocumentOrdinal first_ordinal, DocumentOrdinal last_ordinal) const {
+	size_t count = 0;
+	std::array<DocumentOrdinal, BLOCK_SIZE> ordinals;
+	std::array<float, BLOCK_SIZE> tfs;
+	for (size_t block_index = FindBlock(first_ordinal); block_index < blocks_.size(); ++block_index) {
+		const Block & block = blocks_[block_index];
+		if (block.first_ordinal >= last_ordinal) {
+			return count;
+		}
+		if (block.first_ordinal >= first_ordinal && block.last_ordinal < last_ordinal) {
+			count += block.count;
+			continue;
+		}
+		const size_t block_count = DecodeBlock(block, ordinals.data(), tfs.data());
+		count += std::count_if(ordinals.begin(), ordinals.begin() + block_count,
+			[first_ordinal, last_ordinal](DocumentOrdinal ordinal) {
+				return ordinal >= first_ordinal && ordinal < last_ordinal;
+			});
+	}
+	const auto by_ordinal = [](const Posting & posting, DocumentOrdinal ordinal) {
+		return posting.ordinal < ordinal;
+	};
+	const auto first = std::lower_bound(tail_.begin(), tail_.end(), first_ordinal, by_ordinal);
+	const auto last = std::lower_bound(first, tail_.end(), last_ordinal, by_ordinal);
+	return count + static_cast<size_t>(last - first);
+}
+
+bool PostingList::IsEmpty() const {
+	return size_ == 0;
+}
+
+DocumentOrdinal PostingList::GetLastOrdinal() const {
+	if (!tail_.empty()) {
+		return tail_.back().ordinal;
+	}
+	return blocks_.empty() ? NO_ORDINAL : blocks_.back().last_ordinal;
+}
+
+double PostingList::GetMaxTf() const {
+	return max_tf_;
+}
+
+double PostingList::GetMaxTf(DocumentOrdinal first_ordinal, DocumentOrdinal last_ordinal) const {
+	double max_tf = 0.0;
+	for (size_t block_index = FindBlock(first_ordinal); block_index < blocks_.size(); ++block_index) {
+		const Block & block = blocks_[block_index];
+		if (block.first_ordinal >= last_ordinal) {
+			return max_tf;
+		}
+		max_tf = std::max(max_tf, static_cast<double>(block.max_tf));
+	}
+	for (const Posting & posting : tail_) {
+		if (posting.ordinal >= last_ordinal) {
+			break;
+		}
+		if (posting.ordinal >= first_ordinal) {
+			max_tf = std::max(max_tf, posting.tf);
+		}
+	}
+	return max_tf;
+}
+
+size_t PostingList::GetMemoryUsage() const {
+	return blocks_.capacity() * sizeof(Block) + data_.capacity() + tail_.capacity() * sizeof(Posting);
+}
+
+void PostingList::Add(DocumentOrdinal ordinal, double tf) {
+	tf = QuantizeTf(tf);
+	// Номера выдаются по возрастанию, поэтому новый документ обычно попадает в хвост
+	if (blocks_.empty() || blocks_.back().last_ordinal < ordinal) {
+		auto it = std::lower_bound(tail_.begin(), tail_.end(), ordinal,
+			[](const Posting & posting, DocumentOrdinal value) {
+				return posting.ordinal < value;
+			});
+		if (it != tail_.end() && it->ordinal == ordinal) {
+			it->tf = QuantizeTf(it->tf + tf);
+		} else {
+			it = tail_.insert(it, {ordinal, tf});
+			++size_;
+		}
+		max_tf_ = std::max(max_tf_, it->tf);
+		if (tail_.size() == BLOCK_SIZE) {
+			AppendBlock(tail_.data(), tail_.size());
+			tail_.clear();
+		}
+		return;
+	}
+	// Вставка в сжатую часть переписывает список целиком, это редкий случай
+	std::vector<Posting> postings = DecodeAll();
+	auto it = std::lower_bound(postings.begin(), postings.end(), ordinal,
+		[](const Posting & posting, DocumentOrdinal value) {
+			return posting.ordinal < value;
+		});
+	if (it != postings.end() && it->ordinal == ordinal) {
+		it->tf = QuantizeTf(it->tf + tf);
+	} else {
+		it = postings.insert(it, {ordinal, tf});
+	}
+	max_tf_ = std::max(max_tf_, it->tf);
+	Rebuild(postings);
+}
+
+void PostingList::Reserve(size_t count) {
+	const size_t required = (size_ + count) / BLOCK_SIZE;
+	// Рост не меньше удвоения, чтобы серия мелких пакетов не перевыделяла таблицу блоков каждый раз
+	if (required > blocks_.capacity()) {
+		blocks_.reserve(std::max(required, 2 * blocks_.capacity()));
+	}
+}
+
+void PostingList::Remove(DocumentOrdinal ordinal) {
+	const size_t block_index = FindBlock(ordinal);
+	if (block_index == blocks_.size()) {
+		auto it = std::lower_bound(tail_.begin(), tail_.end(), ordinal,
+			[](const Posting & posting, DocumentOrdinal value) {
+				return posting.ordinal < value;
+			});
+		if (it == tail_.end() || it->ordinal != ordinal) {
+			return;
+		}
+		const bool was_max = it->tf >= max_tf_;
+		tail_.erase(it);
+		--size_;
+		if (was_max) {
+			RecalculateMaxTf();
+		}
+		return;
+	}
+
+	// Перепаковывается только блок с документом, данные следующих блоков сдвигаются.
+	// Неполный блок допустим в любом месте списка
+	Block & block = blocks_[block_index];
+	std::array<DocumentOrdinal, BLOCK_SIZE> ordinals;
+	std::array<float, BLOCK_SIZE> tfs;
+	const size_t count = DecodeBlock(block, ordinals.data(), tfs.data());
+	const size_t position = std::lower_bound(ordinals.begin(), ordinals.begin() + count, ordinal) - ordinals.begin();
+	if (position == count || ordinals[position] != ordinal) {
+		return;
+	}
+	const bool was_max = tfs[position] >= max_tf_;
+	std::vector<Posting> postings;
+	postings.reserve(count - 1);
+	for (size_t i = 0; i < count; ++i) {
+		if (i != position) {
+			postings.push_back({ordinals[i], static_cast<double>(tfs[i])});
+		}
+	}
+	const size_t begin = block.offset;
+	const size_t end = begin + GetDataSize(block);
+	std::vector<uint8_t> data;
+	size_t next_block = block_index;
+	if (postings.empty()) {
+		blocks_.erase(blocks_.begin() + block_index);
+	} else {
+		block = EncodeBlock(postings.data(), postings.size(), data);
+		block.offset = static_cast<uint32_t>(begin);
+		++next_block;
+	}
+	data_.erase(data_.begin() + begin, data_.begin() + end);
+	data_.insert(data_.begin() + begin, data.begin(), data.end());
+	for (; next_block < blocks_.size(); ++next_block) {
+		blocks_[next_block].offset = static_cast<uint32_t>(blocks_[next_block].offset - (end - begin) + data.size());
+	}
+	--size_;
+	// Удаление и так перепаковывает блок, поэтому границу пересчитываем сразу, а не держим завышенной
+	if (was_max) {
+		RecalculateMaxTf();
+	}
+}
+
+bool PostingList::Contains(DocumentOrdinal ordinal) const {
+	const Cursor cursor(*this, ordinal, NO_ORDINAL);
+	return cursor.GetOrdinal() == ordinal;
+}
+
+void PostingList::Assign(const Posting * first, const Posting * last) {
+	std::vector<Posting> postings(first, last);
+	for (Posting & posting : postings) {
+		posting.tf = QuantizeTf(posting.tf);
+	}
+	Rebuild(postings);
+	RecalculateMaxTf();
+}
+
+void PostingList::Remap(const std::vector<DocumentOrdinal> & new_ordinals) {
+	std::vector<Posting> postings = DecodeAll();
+	size_t kept = 0;
+	for (const Posting & posting : postings) {
+		const DocumentOrdinal ordinal = new_ordinals[posting.ordinal];
+		if (ordinal != NO_ORDINAL) {
+			postings[kept++] = {ordinal, posting.tf};
+		}
+	}
+	postings.resize(kept);
+	Rebuild(postings);
+}
+
+PostingList::Block PostingList::EncodeBlock(const Posting * postings, size_t count, std::vector<uint8_t> & data) {
+	Block block;
+	block.first_ordinal = postings[0].ordinal;
+	block.last_ordinal = postings[count - 1].ordinal;
+	block.count = static_cast<uint8_t>(count);
+
+	// Первая разность нулевая: блок начинается с first_ordinal
+	std::array<uint32_t, BLOCK_SIZE> deltas;
+	uint32_t max_delta = 0;
+	for (size_t i = 0; i < count; ++i) {
+		deltas[i] = i == 0 ? 0 : postings[i].ordinal - postings[i - 1].ordinal;
+		max_delta = std::max(max_delta, deltas[i]);
+	}
+	block.delta_bits = GetBitWidth(max_delta);
+
+	// Таблица различных tf строится открытой адресацией по битам float за один проход
+	constexpr size_t SLOT_COUNT = 2 * BLOCK_SIZE;
+	constexpr uint32_t EMPTY_SLOT = std::numeric_limits<uint32_t>::max();
+	std::array<uint32_t, SLOT_COUNT> slot_values;
+	std::array<uint8_t, SLOT_COUNT> slot_indices;
+	slot_values.fill(EMPTY_SLOT);
+	std::array<float, BLOCK_SIZE> tfs;
+	std::array<float, BLOCK_SIZE> tf_values;
+	std::array<uint32_t, BLOCK_SIZE> tf_indices;
+	size_t tf_count = 0;
+	block.max_tf = 0.0f;
+	for (size_t i = 0; i < count; ++i) {
+		tfs[i] = static_cast<float>(postings[i].tf);
+		block.max_tf = std::max(block.max_tf, tfs[i]);
+		uint32_t value;
+		std::memcpy(&value, &tfs[i], sizeof(value));
+		size_t slot = (value * 0x9E3779B1u) >> 24;
+		while (slot_values[slot] != EMPTY_SLOT && slot_values[slot] != value) {
+			slot = (slot + 1) % SLOT_COUNT;
+		}
+		if (slot_values[slot] == EMPTY_SLOT) {
+			slot_values[slot] = value;
+			slot_indices[slot] = static_cast<uint8_t>(tf_count);
+			tf_values[tf_count++] = tfs[i];
+		}
+		tf_indices[i] = slot_indices[slot];
+	}
+	const uint8_t tf_bits = GetBitWidth(static_cast<uint32_t>(tf_count - 1));
+
+	block.offset = static_cast<uint32_t>(data.size());
+	// Таблица не окупается, если почти все tf блока различны: тогда tf пишутся как есть
+	if (tf_count * sizeof(float) + GetPackedSize(tf_bits, count) >= count * sizeof(float)) {
+		block.tf_count = 0;
+		block.tf_bits = RAW_TF_BITS;
+		PackBits(deltas.data(), block.delta_bits, count, data);
+		const size_t tf_offset = data.size();
+		data.resize(tf_offset + count * sizeof(float));
+		std::memcpy(data.data() + tf_offset, tfs.data(), count * sizeof(float));
+		return block;
+	}
+	block.tf_count = static_cast<uint8_t>(tf_count);
+	block.tf_bits = tf_bits;
+	data.resize(data.size() + tf_count * sizeof(float));
+	std::memcpy(data.data() + block.offset, tf_values.data(), tf_count * sizeof(float));
+	PackBits(deltas.data(), block.delta_bits, count, data);
+	PackBits(tf_indices.data(), block.tf_bits, count, data);
+	return block;
+}
+
+size_t PostingList::GetDataSize(const Block & block) {
+	const size_t tf_size = block.tf_bits == RAW_TF_BITS
+		? block.count * sizeof(float)
+		: GetPackedSize(block.tf_bits, block.count);
+	return block.tf_count * sizeof(float) + GetPackedSize(block.delta_bits, block.count) + tf_size;
+}
+
+size_t PostingList::DecodeBlock(const Block & block, DocumentOrdinal * ordinals, float * tfs) const {
+	const uint8_t * tf_values = data_.data() + block.offset;
+	const uint8_t * deltas = tf_values + block.tf_count * sizeof(float);
+	DecodeOrdinals(deltas, block.delta_bits, block.count, block.first_ordinal, ordinals);
+	if (block.tf_bits == RAW_TF_BITS) {
+		std::memcpy(tfs, deltas + GetPackedSize(block.delta_bits, block.count), block.count * sizeof(float));
+		return block.count;
+	}
+	if (block.tf_bits == 0) {
+		std::fill(tfs, tfs + block.count, block.max_tf);
+		return block.count;
+	}
+	std::array<float, BLOCK_SIZE> values;
+	std::memcpy(values.data(), tf_values, block.tf_count * sizeof(float));
+	std::array<uint32_t, BLOCK_SIZE> tf_indices;
+	UnpackBits(deltas + GetPackedSize(block.delta_bits, block.count), block.tf_bits, block.count, tf_indices.data());
+	for (size_t i = 0; i < block.count; ++i) {
+		tfs[i] = values[tf_indices[i]];
+	}
+	return block.count;
+}
+
+void PostingList::AppendBlock(const Posting * postings, size_t count) {
+	if (!data_.empty()) {
+		data_.resize(data_.size() - PADDING);
+	}
+	blocks_.push_back(EncodeBlock(postings, count, data_));
+	data_.resize(data_.size() + PADDING, 0);
+}
+
+size_t PostingList::FindBlock(DocumentOrdinal ordinal) const {
+	auto it = std::lower_bound(blocks_.begin(), blocks_.end(), ordinal,
+		[](const Block & block, DocumentOrdinal value) {
+			return block.last_ordinal < value;
+		});
+	return static_cast<size_t>(it - blocks_.begin());
+}
+
+std::vector<PostingList::Posting> PostingList::DecodeAll() const {
+	std::vector<Posting> postings;
+	postings.reserve(size_);
+	ForEach(0, NO_ORDINAL, [&postings](DocumentOrdinal ordinal, double tf) {
+		postings.push_back({ordinal, tf});
+	});
+	return postings;
+}
+
+void PostingList::Rebuild(const std::vector<Posting> & postings) {
+	const size_t block_count = postings.size() / BLOCK_SIZE;
+	blocks_.clear();
+	blocks_.reserve(block_count);
+	data_.clear();
+	for (size_t i = 0; i < block_count; ++i) {
+		blocks_.push_back(EncodeBlock(postings.data() + i * BLOCK_SIZE, BLOCK_SIZE, data_));
+	}
+	if (block_count > 0) {
+		data_.resize(data_.size() + PADDING, 0);
+	}
+	data_.shrink_to_fit();
+	tail_.assign(postings.begin() + block_count * BLOCK_SIZE, postings.end());
+	size_ = postings.size();
+}
+
+void PostingList::Save(SnapshotWriter & writer) const {
+	// В Block нет байтов выравнивания, поэтому заголовки пишутся массивом
+	writer.Write(static_cast<uint64_t>(blocks_.size()));
+	writer.Align(alignof(Block));
+	writer.WriteBytes(blocks_.data(), blocks_.size() * sizeof(Block));
+	writer.Write(static_cast<uint64_t>(data_.size()));
+	writer.WriteBytes(data_.data(), data_.size());
+	writer.Write(static_cast<uint64_t>(tail_.size()));
+	writer.Align(alignof(Posting));
+	for (const Posting & posting : tail_) {
+		writer.Write(posting.ordinal);
+		writer.Write(uint32_t{0});
+		writer.Write(posting.tf);
+	}
+}
+
+PostingList PostingList::Load(SnapshotReader & reader, DocumentOrdinal ordinal_count) {
+	const auto corrupted = [] {
+		return std::runtime_error("Snapshot is corrupted");
+	};
+	PostingList postings;
+	const uint64_t block_count = reader.Read<uint64_t>();
+	const Block * blocks = reader.ReadArray<Block>(block_count);
+	postings.blocks_.assign(blocks, blocks + block_count);
+	const uint64_t data_size = reader.Read<uint64_t>();
+	const uint8_t * data = reader.ReadArray<uint8_t>(data_size);
+	postings.data_.assign(data, data + data_size);
+	const uint64_t tail_size = reader.Read<uint64_t>();
+	const Posting * tail = reader.ReadArray<Posting>(tail_size);
+	postings.tail_.assign(tail, tail + tail_size);
+
+	// Данные блоков должны идти подряд и заканчиваться запасом PADDING байт
+	if (data_size != (block_count == 0 ? 0 : postings.blocks_.back().offset
+		+ GetDataSize(postings.blocks_.back()) + PADDING))
+	{
+		throw corrupted();
+	}
+	size_t offset = 0;
+	DocumentOrdinal next_ordinal = 0;
+	std::array<DocumentOrdinal, BLOCK_SIZE> ordinals;
+	std::array<float, BLOCK_SIZE> tfs;
+	std::array<uint32_t, BLOCK_SIZE> tf_indices;
+	for (const Block & block : postings.blocks_) {
+		const bool is_raw = block.tf_bits == RAW_TF_BITS;
+		if (block.offset != offset || block.count == 0 || block.count > BLOCK_SIZE || block.delta_bits > 32
+			|| (is_raw ? block.tf_count != 0 : block.tf_count == 0 || block.tf_count > BLOCK_SIZE || block.tf_bits > 8
+				|| (size_t{1} << block.tf_bits) < block.tf_count))
+		{
+			throw corrupted();
+		}
+		offset += GetDataSize(block);
+		if (offset > data_size - PADDING) {
+			throw corrupted();
+		}
+		// Номер tf вне таблицы прочитал бы память за ней
+		if (!is_raw && block.tf_bits > 0) {
+			const uint8_t * packed = postings.data_.data() + block.offset + block.tf_count * sizeof(float)
+				+ GetPackedSize(block.delta_bits, block.count);
+			UnpackBits(packed, block.tf_bits, block.count, tf_indices.data());
+			for (size_t i = 0; i < block.count; ++i) {
+				if (tf_indices[i] >= block.tf_count) {
+					throw corrupted();
+				}
+			}
+		}
+		const size_t count = postings.DecodeBlock(block, ordinals.data(), tfs.data());
+		float max_tf = 0.0f;
+		for (size_t i = 0; i < count; ++i) {
+			if (ordinals[i] < next_ordinal || ordinals[i] >= ordinal_count || !(tfs[i] >= 0.0f) || std::isinf(tfs[i])) {
+				throw corrupted();
+			}
+			next_ordinal = ordinals[i] + 1;
+			max_tf = std::max(max_tf, tfs[i]);
+		}
+		if (ordinals[0] != block.first_ordinal || ordinals[count - 1] != block.last_ordinal
+			|| max_tf != block.max_tf)
+		{
+			throw corrupted();
+		}
+		postings.size_ += count;
+		postings.max_tf_ = std::max(postings.max_tf_, static_cast<double>(max_tf));
+	}
+	for (const Posting & posting : postings.tail_) {
+		if (posting.ordinal < next_ordinal || posting.ordinal >= ordinal_count
+			|| posting.tf != QuantizeTf(posting.tf) || !(posting.tf >= 0.0) || std::isinf(posting.tf))
+		{
+			throw corrupted();
+		}
+		next_ordinal = posting.ordinal + 1;
+		postings.max_tf_ = std::max(postings.max_tf_, posting.tf);
+	}
+	postings.size_ += postings.tail_.size();
+	return postings;
+}
+
+void PostingList::RecalculateMaxTf() {
+	max_tf_ = 0.0;
+	ForEach(0, NO_ORDINAL, [this](DocumentOrdinal, double tf) {
+		max_tf_ = std::max(max_tf_, tf);
+	});
+}
@@ -0,0 +1,202 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <limits>
+#include <vector>
+#include "document.h"
+
+class SnapshotReader;
+class SnapshotWriter;
+
+// Распаковывает count чисел шириной bits бит (от 0 до 32), записанных подряд с младших бит.
+// За концом упакованных данных должно быть доступно PostingList::PADDING байт.
+// Версия с SIMD использует AVX2, если его поддерживает процессор, иначе совпадает со скалярной
+void UnpackBits(const uint8_t * packed, uint8_t bits, size_t count, uint32_t * values);
+void UnpackBitsScalar(const uint8_t * packed, uint8_t bits, size_t count, uint32_t * values);
+// Распаковывает count разностей шириной bits бит и восстанавливает номера документов:
+// ordinals[i] = base + deltas[0] + ... + deltas[i]. Префиксная сумма считается инструкциями
+// AVX2 или SSE2, если они доступны
+void DecodeOrdinals(const uint8_t * packed, uint8_t bits, size_t count,
+	DocumentOrdinal base, DocumentOrdinal * ordinals);
+void DecodeOrdinalsScalar(const uint8_t * packed, uint8_t bits, size_t count,
+	DocumentOrdinal base, DocumentOrdinal * ordinals);
+
+// Сжатый список вхождений слова, упорядоченный по номеру документа.
+// Вхождения хранятся блоками по BLOCK_SIZE в одном общем буфере. Номера документов
+// записаны разностями соседних номеров, упакованными по числу бит наибольшей разности блока.
+// tf записан номером значения в таблице различных tf блока, тоже упакованным по битам, поэтому
+// блок документов одинаковой длины с одним вхождением слова тратит на tf только таблицу.
+// Если почти все tf блока различны, они хранятся числами float без таблицы.
+// Заголовки блоков лежат отдельно: первый и последний номер служат таблицей пропусков,
+// наибольший tf блока - оценкой вклада слова в участок номеров. Последние вхождения, еще
+// не набравшие блок, хранятся несжатыми, поэтому добавление нового документа дешевое
+class PostingList {
+public:
+	static constexpr size_t BLOCK_SIZE = 128;
+	// Запас нулевых байт за концом буфера блоков: распаковка читает по 8 байт
+	static constexpr size_t PADDING = 8;
+	static constexpr DocumentOrdinal NO_ORDINAL = std::numeric_limits<DocumentOrdinal>::max();
+
+	struct Posting {
+		DocumentOrdinal ordinal;
+		double tf;
+	};
+
+	// Последовательный обход вхождений из отрезка номеров [first, last).
+	// Блоки распаковываются по мере продвижения, SkipTo перепрыгивает блоки по заголовкам
+	class Cursor {
+	public:
+		Cursor(const PostingList & postings, DocumentOrdinal first_ordinal, DocumentOrdinal last_ordinal);
+
+		bool IsEnd() const {
+			return ordinal_ == NO_ORDINAL;
+		}
+		// Номер текущего документа или NO_ORDINAL после конца отрезка
+		DocumentOrdinal GetOrdinal() const {
+			return ordinal_;
+		}
+		double GetTf() const {
+			return tfs_[position_];
+		}
+		// Встроен: по нему обходятся списки при подсчете релевантности
+		void Next() {
+			if (IsEnd()) {
+				return;
+			}
+			if (++position_ < count_) {
+				UpdateOrdinal();
+			} else if (block_index_ < postings_->blocks_.size()) {
+				LoadBlock(block_index_ + 1, 0);
+			} else {
+				ordinal_ = NO_ORDINAL;
+			}
+		}
+		// Переходит к первому вхождению с номером не меньше ordinal
+		void SkipTo(DocumentOrdinal ordinal);
+
+	private:
+		const PostingList * postings_;
+		DocumentOrdinal last_ordinal_;
+		DocumentOrdinal ordinal_ = NO_ORDINAL;
+		// Блок в буфере. Индекс, равный числу блоков, обозначает несжатый хвост
+		size_t block_index_ = 0;
+		size_t position_ = 0;
+		size_t count_ = 0;
+		std::array<DocumentOrdinal, BLOCK_SIZE> ordinals_;
+		std::array<float, BLOCK_SIZE> tfs_;
+
+		// Загружает блок в буфер и встает на его первое вхождение с номером не меньше ordinal
+		void LoadBlock(size_t block_index, DocumentOrdinal ordinal);
+		void UpdateOrdinal() {
+			ordinal_ = position_ < count_ && ordinals_[position_] < last_ordinal_
+				? ordinals_[position_]
+				: NO_ORDINAL;
+		}
+	};
+
+	// tf хранится с точностью float
+	static double QuantizeTf(double tf);
+
+	size_t GetSize() const;
+	// Число вхождений с номерами из [first_ordinal, last_ordinal). Блоки, целиком лежащие
+	// в отрезке, считаются по заголовкам, распаковываются только граничные
+	size_t CountInRange(DocumentOrdinal first_ordinal, DocumentOrdinal last_ordinal) const;
+	bool IsEmpty() const;
+	// Номер последнего вхождения, NO_ORDINAL для пустого списка
+	DocumentOrdinal GetLastOrdinal() const;
+	double GetMaxTf() const;
+	// Верхняя граница tf вхождений с номерами из [first_ordinal, last_ordinal): наибольший tf
+	// блоков, пересекающих отрезок, без распаковки. 0, если вхождений в отрезке нет
+	double GetMaxTf(DocumentOrdinal first_ordinal, DocumentOrdinal last_ordinal) const;
+	// Память, занятая вхождениями, в байтах
+	size_t GetMemoryUsage() const;
+
+	// Добавляет к tf документа значение tf
+	void Add(DocumentOrdinal ordinal, double tf);
+	// Готовит таблицу блоков к добавлению count вхождений
+	void Reserve(size_t count);
+	void Remove(DocumentOrdinal ordinal);
+	bool Contains(DocumentOrdinal ordinal) const;
+	// Заменяет список массивом [first, last), упорядоченным по номеру документа
+	void Assign(const Posting * first, const Posting * last);
+	// Заменяет номера документов на new_ordinals[номер] с сохранением порядка.
+	// Вхождения с новым номером NO_ORDINAL выбрасываются
+	void Remap(const std::vector<DocumentOrdinal> & new_ordinals);
+
+	// Записывает заголовки блоков, данные блоков и хвост в снимок как есть, без распаковки
+	void Save(SnapshotWriter & writer) const;
+	// Читает список, записанный Save, копируя массивы целиком без перепаковки. Блоки
+	// распаковываются только для проверки, что поврежденный файл не даст чтения за границами
+	// данных и номеров вне [0, ordinal_count)
+	static PostingList Load(SnapshotReader & reader, DocumentOrdinal ordinal_count);
+
+	// Вызывает function(ordinal, tf) для вхождений с номерами из [first_ordinal, last_ordinal)
+	template <typename Function>
+	void ForEach(DocumentOrdinal first_ordinal, DocumentOrdinal last_ordinal, Function function) const;
+
+private:
+	struct Block {
+		DocumentOrdinal first_ordinal;
+		DocumentOrdinal last_ordinal;
+		// Смещение данных блока в data_: таблица tf, затем упакованные разности номеров
+		// (первая нулевая) и упакованные номера tf в таблице. Если таблица не окупается,
+		// tf_bits равно RAW_TF_BITS, а за разностями лежат сами tf. Данные списка меньше 4 ГиБ
+		uint32_t offset;
+		float max_tf;
+		uint8_t count;
+		uint8_t delta_bits;
+		uint8_t tf_bits;
+		uint8_t tf_count;
+	};
+
+	static constexpr uint8_t RAW_TF_BITS = 32;
+
+	std::vector<Block> blocks_;
+	// Данные всех блоков подряд и PADDING нулевых байт в конце
+	std::vector<uint8_t> data_;
+	std::vector<Posting> tail_;
+	size_t size_ = 0;
+	double max_tf_ = 0.0;
+
+	// Упаковывает вхождения в конец data_ и возвращает заголовок блока
+	static Block EncodeBlock(const Posting * postings, size_t count, std::vector<uint8_t> & data);
+	// Размер данных блока в data_ по его заголовку
+	static size_t GetDataSize(const Block & block);
+	size_t DecodeBlock(const Block & block, DocumentOrdinal * ordinals, float * tfs) const;
+	void AppendBlock(const Posting * postings, size_t count);
+	// Первый блок, последний номер которого не меньше ordinal
+	size_t FindBlock(DocumentOrdinal ordinal) const;
+	std::vector<Posting> DecodeAll() const;
+	// Раскладывает вхождения по полным блокам, остаток оставляет в хвосте
+	void Rebuild(const std::vector<Posting> & postings);
+	void RecalculateMaxTf();
+};
+
+template <typename Function>
+void PostingList::ForEach(DocumentOrdinal first_ordinal, DocumentOrdinal last_ordinal,
+	Function function) const
+{
+	std::array<DocumentOrdinal, BLOCK_SIZE> ordinals;
+	std::array<float, BLOCK_SIZE> tfs;
+	for (size_t block_index = FindBlock(first_ordinal); block_index < blocks_.size(); ++block_index) {
+		const Block & block = blocks_[block_index];
+		if (block.first_ordinal >= last_ordinal) {
+			return;
+		}
+		const size_t count = DecodeBlock(block, ordinals.data(), tfs.data());
+		for (size_t i = 0; i < count; ++i) {
+			if (ordinals[i] >= first_ordinal && ordinals[i] < last_ordinal) {
+				function(ordinals[i], static_cast<double>(tfs[i]));
+			}
+		}
+	}
+	for (const Posting & posting : tail_) {
+		if (posting.ordinal >= last_ordinal) {
+			return;
+		}
+		if (posting.ordinal >= first_ordinal) {
+			function(posting.ordinal, posting.tf);
+		}
+	}
+}
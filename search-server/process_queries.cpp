@@ -1,6 +1,5 @@
 #include "process_queries.h"
 #include <algorithm>
-#include <execution>
 
 
 std::vector<std::vector<Document>> ProcessQueries(
@@ -8,10 +7,10 @@ std::vector<std::vector<Document>> ProcessQueries(
 	const std::vector<std::string>& queries)
 {
 	std::vector<std::vector<Document>> documents_lists(queries.size());
-	std::transform(std::execution::par, queries.begin(), queries.end(), documents_lists.begin(),
-		[&search_server](const std::string & query){
-			return search_server.FindTopDocuments(query);
-		});
+	// Запросы выполняются в пуле сервера, который делят и параллельные версии его методов
+	search_server.GetThreadPool().ParallelFor(queries.size(), [&](size_t i) {
+		documents_lists[i] = search_server.FindTopDocuments(queries[i]);
+	});
 	return documents_lists;
 }
 
@@ -19,12 +18,50 @@ std::list<Document> ProcessQueriesJoined(
 	const SearchServer& search_server,
 	const std::vector<std::string>& queries)
 {
-	std::vector<std::vector<Document>> documents_lists = ProcessQueries(search_server, queries);
-	std::list<Document> result;
-	for (auto list : documents_lists) {
-		for (auto document : list) {
-			result.push_back(document);
-		}
+	const FlatQueryResults results = ProcessQueriesFlat(search_server, queries);
+	return std::list<Document>(results.documents.begin(), results.documents.end());
+}
+
+size_t FlatQueryResults::GetQueryCount() const {
+	return offsets.empty() ? 0 : offsets.size() - 1;
+}
+
+IteratorRange<std::vector<Document>::const_iterator> FlatQueryResults::GetDocuments(
+	size_t query_index) const
+{
+	const size_t first = offsets.at(query_index);
+	const size_t last = offsets.at(query_index + 1);
+	return IteratorRange(documents.begin() + first, documents.begin() + last,
+		static_cast<unsigned>(last - first));
+}
+
+FlatQueryResults ProcessQueriesFlat(
+	const SearchServer& search_server,
+	const std::vector<std::string>& queries)
+{
+	// Запрос возвращает не больше MAX_RESULT_DOCUMENT_COUNT документов, поэтому каждая задача
+	// пишет результат сразу в свой участок общего массива. Одно выделение памяти на весь пакет
+	// вместо узла списка на каждый документ
+	constexpr size_t SLOT_SIZE = MAX_RESULT_DOCUMENT_COUNT;
+	FlatQueryResults results;
+	results.documents.resize(queries.size() * SLOT_SIZE);
+	std::vector<size_t> counts(queries.size());
+	search_server.GetThreadPool().ParallelFor(queries.size(), [&](size_t i) {
+		// Контекст потока сохраняет буферы между запросами пакета
+		static thread_local SearchServer::QueryContext context;
+		const std::vector<Document> & documents = search_server.FindTopDocuments(context, queries[i]);
+		std::copy(documents.begin(), documents.end(), results.documents.begin() + i * SLOT_SIZE);
+		counts[i] = documents.size();
+	});
+
+	// Участки сдвигаются к началу по порядку: участок i переезжает не правее своего места
+	results.offsets.reserve(queries.size() + 1);
+	results.offsets.push_back(0);
+	for (size_t i = 0; i < queries.size(); ++i) {
+		const auto slot = results.documents.begin() + i * SLOT_SIZE;
+		std::copy(slot, slot + counts[i], results.documents.begin() + results.offsets.back());
+		results.offsets.push_back(results.offsets.back() + counts[i]);
 	}
-	return result;
+	results.documents.resize(results.offsets.back());
+	return results;
 }
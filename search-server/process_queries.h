@@ -1,9 +1,13 @@
 #pragma once
 
+#include <deque>
 #include <vector>
 #include <list>
 #include <string>
+#include <mutex>
+#include <utility>
 #include "search_server.h"
+#include "paginator.h"
 
 std::vector<std::vector<Document>> ProcessQueries(
 	const SearchServer& search_server,
@@ -12,3 +16,50 @@ std::vector<std::vector<Document>> ProcessQueries(
 std::list<Document> ProcessQueriesJoined(
 	const SearchServer& search_server,
 	const std::vector<std::string>& queries);
+
+// Результаты пакета запросов в одном непрерывном массиве.
+// Документы запроса i занимают documents[offsets[i], offsets[i + 1])
+struct FlatQueryResults {
+	std::vector<Document> documents;
+	std::vector<size_t> offsets;
+
+	size_t GetQueryCount() const;
+	IteratorRange<std::vector<Document>::const_iterator> GetDocuments(size_t query_index) const;
+};
+
+FlatQueryResults ProcessQueriesFlat(
+	const SearchServer& search_server,
+	const std::vector<std::string>& queries);
+
+// Вызывает callback(query_index, documents) по мере готовности каждого запроса.
+// Запросы выполняются параллельно, но вызовы callback не пересекаются по времени
+template <typename Callback>
+void ProcessQueriesStreaming(
+	const SearchServer& search_server,
+	const std::vector<std::string>& queries,
+	Callback callback)
+{
+	// Готовые результаты ставятся в очередь. Поток, заставший очередь без разборщика, сам
+	// вызывает callback для всех результатов в ней, отпуская мьютекс на время вызова,
+	// поэтому остальные потоки не ждут callback и сразу берутся за следующие запросы
+	std::mutex queue_mutex;
+	std::deque<std::pair<size_t, std::vector<Document>>> ready;
+	bool is_delivering = false;
+	search_server.GetThreadPool().ParallelFor(queries.size(), [&](size_t i) {
+		std::vector<Document> documents = search_server.FindTopDocuments(queries[i]);
+		std::unique_lock lock(queue_mutex);
+		ready.emplace_back(i, std::move(documents));
+		if (is_delivering) {
+			return;
+		}
+		is_delivering = true;
+		while (!ready.empty()) {
+			auto [query_index, query_documents] = std::move(ready.front());
+			ready.pop_front();
+			lock.unlock();
+			callback(query_index, std::move(query_documents));
+			lock.lock();
+		}
+		is_delivering = false;
+	});
+}
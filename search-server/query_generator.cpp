@@ -1,5 +1,6 @@
 #include "query_generator.h"
 #include <algorithm>
+#include <utility>
 
 std::string GenerateWord(std::mt19937& generator, int max_length) {
 	const int length = std::uniform_int_distribution(1, max_length)(generator);
@@ -74,3 +75,27 @@ std::vector<std::string> GenerateQueriesStrict(std::mt19937& generator,
 	}
 	return queries;
 }
+
+std::vector<std::string> GenerateQueriesZipf(std::mt19937& generator,
+	const std::vector<std::string>& dictionary,
+	int query_count, int word_count)
+{
+	std::vector<double> weights(dictionary.size());
+	for (size_t i = 0; i < weights.size(); ++i) {
+		weights[i] = 1.0 / static_cast<double>(i + 1);
+	}
+	std::discrete_distribution<size_t> word_distribution(weights.begin(), weights.end());
+	std::vector<std::string> queries;
+	queries.reserve(query_count);
+	for (int i = 0; i < query_count; ++i) {
+		std::string query;
+		for (int j = 0; j < word_count; ++j) {
+			if (!query.empty()) {
+				query.push_back(' ');
+			}
+			query += dictionary[word_distribution(generator)];
+		}
+		queries.push_back(std::move(query));
+	}
+	return queries;
+}
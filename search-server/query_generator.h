@@ -18,3 +18,8 @@ std::string GenerateQueryStrict(std::mt19937& generator,
 std::vector<std::string> GenerateQueriesStrict(std::mt19937& generator,
 	const std::vector<std::string>& dictionary,
 	int query_count, int max_word_count);
+// Слова выбираются с вероятностью, обратной их номеру в словаре (закон Ципфа),
+// как в текстах на естественном языке: немногие слова часты, большинство - редки
+std::vector<std::string> GenerateQueriesZipf(std::mt19937& generator,
+	const std::vector<std::string>& dictionary,
+	int query_count, int word_count);
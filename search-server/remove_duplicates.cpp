@@ -1,30 +1,290 @@
 #include "remove_duplicates.h"
 
-#include <set>
-#include <string>
-#include <iostream>
 #include <algorithm>
+#include <cstdint>
+#include <limits>
+#include <stdexcept>
+#include <tuple>
+#include <utility>
 
-using std::literals::string_literals::operator""s;
+namespace {
 
-void RemoveDuplicates(SearchServer& search_server) {
-	std::vector<int> duplicates;
-	std::set<std::vector<std::string_view>> scanned;
-	for (int document_id : search_server) {
-		// Т.к. GetWordFrequencies возвращает map, то слова будут без дублей
-		// поэтому используем vector для быстрой вставки элементов
-		std::vector<std::string_view> document_words;
-		for (const auto& [word, freq] : search_server.GetWordFrequencies(document_id)) {
-			document_words.push_back(word);
-		}
-		if (scanned.count(document_words)) {
-			duplicates.push_back(document_id);
+// 128-битный отпечаток набора слов документа
+struct Fingerprint {
+	uint64_t high = 0;
+	uint64_t low = 0;
+
+	bool operator==(const Fingerprint& other) const {
+		return high == other.high && low == other.low;
+	}
+	bool operator<(const Fingerprint& other) const {
+		return std::tie(high, low) < std::tie(other.high, other.low);
+	}
+};
+
+// Финальное перемешивание splitmix64
+uint64_t Mix(uint64_t value) {
+	value ^= value >> 30;
+	value *= 0xbf58476d1ce4e5b9ULL;
+	value ^= value >> 27;
+	value *= 0x94d049bb133111ebULL;
+	value ^= value >> 31;
+	return value;
+}
+
+// Слова документа упорядочены по id, поэтому одинаковые наборы слов дают
+// одинаковые отпечатки. Половины отпечатка считаются с разными множителями
+Fingerprint ComputeFingerprint(const std::vector<InvertedIndex::TermFrequency>& terms) {
+	Fingerprint fingerprint{Mix(terms.size()), Mix(~static_cast<uint64_t>(terms.size()))};
+	for (const auto& [term_id, tf] : terms) {
+		fingerprint.high = Mix(fingerprint.high * 0x9e3779b97f4a7c15ULL + term_id);
+		fingerprint.low = Mix(fingerprint.low * 0xc2b2ae3d27d4eb4fULL + term_id + 1);
+	}
+	return fingerprint;
+}
+
+bool HasSameTerms(const std::vector<InvertedIndex::TermFrequency>& lhs,
+	const std::vector<InvertedIndex::TermFrequency>& rhs)
+{
+	return std::equal(lhs.begin(), lhs.end(), rhs.begin(), rhs.end(),
+		[](const auto& lhs_term, const auto& rhs_term) {
+			return lhs_term.term_id == rhs_term.term_id;
+		});
+}
+
+struct FingerprintedDocument {
+	Fingerprint fingerprint;
+	int document_id;
+
+	bool operator<(const FingerprintedDocument& other) const {
+		return std::tie(fingerprint, document_id) < std::tie(other.fingerprint, other.document_id);
+	}
+};
+
+// Хэши множества MinHash: h(x) = (a * x + b) >> 32 для нечетного a (multiply-shift)
+struct MinHashFunction {
+	uint64_t a;
+	uint64_t b;
+
+	uint32_t operator()(uint64_t value) const {
+		return static_cast<uint32_t>((a * value + b) >> 32);
+	}
+};
+
+std::vector<MinHashFunction> MakeMinHashFunctions(size_t count, uint64_t seed) {
+	std::vector<MinHashFunction> functions;
+	functions.reserve(count);
+	for (size_t i = 0; i < count; ++i) {
+		seed += 0x9e3779b97f4a7c15ULL;
+		const uint64_t a = Mix(seed) | 1;
+		seed += 0x9e3779b97f4a7c15ULL;
+		functions.push_back({a, Mix(seed)});
+	}
+	return functions;
+}
+
+double ComputeJaccard(const std::vector<InvertedIndex::TermFrequency>& lhs,
+	const std::vector<InvertedIndex::TermFrequency>& rhs)
+{
+	size_t common = 0;
+	auto lhs_it = lhs.begin();
+	auto rhs_it = rhs.begin();
+	while (lhs_it != lhs.end() && rhs_it != rhs.end()) {
+		if (lhs_it->term_id < rhs_it->term_id) {
+			++lhs_it;
+		} else if (rhs_it->term_id < lhs_it->term_id) {
+			++rhs_it;
 		} else {
-			scanned.insert(document_words);
+			++common;
+			++lhs_it;
+			++rhs_it;
 		}
 	}
-	for (int document_id : duplicates) {
-		std::cout << "Found duplicate document id "s << document_id << std::endl;
-		search_server.RemoveDocument(document_id);
+	return static_cast<double>(common) / static_cast<double>(lhs.size() + rhs.size() - common);
+}
+
+// Ключ полосы подписи и номер документа в порядке возрастания id
+struct BandedDocument {
+	uint64_t band_key;
+	uint32_t index;
+
+	bool operator<(const BandedDocument& other) const {
+		return std::tie(band_key, index) < std::tie(other.band_key, other.index);
 	}
+};
+
+// Пара кандидатов: номер возможного почти дубликата и номер документа с меньшим id
+using CandidatePair = std::pair<uint32_t, uint32_t>;
+
+} // namespace
+
+std::vector<int> FindDuplicates(const SearchServer& search_server) {
+	const std::vector<int> document_ids(search_server.begin(), search_server.end());
+	ThreadPool& thread_pool = search_server.GetThreadPool();
+	// Мелкие части не окупают запуск потоков
+	constexpr size_t MIN_DOCUMENTS_PER_PART = 1024;
+	const size_t part_count = std::clamp<size_t>(document_ids.size() / MIN_DOCUMENTS_PER_PART,
+		1, thread_pool.GetConcurrency());
+
+	// Каждый поток считает отпечатки своей части документов и раскладывает их по группам
+	// отпечатков. Документы с одинаковым отпечатком попадают в одну группу
+	std::vector<std::vector<std::vector<FingerprintedDocument>>> part_groups(part_count,
+		std::vector<std::vector<FingerprintedDocument>>(part_count));
+	thread_pool.ParallelFor(part_count, [&](size_t part) {
+		const size_t first = document_ids.size() * part / part_count;
+		const size_t last = document_ids.size() * (part + 1) / part_count;
+		for (size_t i = first; i < last; ++i) {
+			const Fingerprint fingerprint = ComputeFingerprint(search_server.GetDocumentTerms(document_ids[i]));
+			part_groups[part][fingerprint.high % part_count].push_back({fingerprint, document_ids[i]});
+		}
+	});
+
+	// Каждая группа упорядочивается независимо. В серии одинаковых отпечатков
+	// документ сравнивается с уже найденными в серии различными наборами слов
+	std::vector<std::vector<int>> group_duplicates(part_count);
+	thread_pool.ParallelFor(part_count, [&](size_t group) {
+		std::vector<FingerprintedDocument> documents;
+		for (const auto& groups : part_groups) {
+			documents.insert(documents.end(), groups[group].begin(), groups[group].end());
+		}
+		std::sort(documents.begin(), documents.end());
+		std::vector<int> originals;
+		for (size_t i = 0; i < documents.size(); ++i) {
+			if (i == 0 || !(documents[i - 1].fingerprint == documents[i].fingerprint)) {
+				originals.clear();
+			}
+			const auto& terms = search_server.GetDocumentTerms(documents[i].document_id);
+			const bool is_duplicate = std::any_of(originals.begin(), originals.end(), [&](int original_id) {
+				return HasSameTerms(search_server.GetDocumentTerms(original_id), terms);
+			});
+			if (is_duplicate) {
+				group_duplicates[group].push_back(documents[i].document_id);
+			} else {
+				originals.push_back(documents[i].document_id);
+			}
+		}
+	});
+
+	std::vector<int> duplicates;
+	for (const std::vector<int>& group : group_duplicates) {
+		duplicates.insert(duplicates.end(), group.begin(), group.end());
+	}
+	std::sort(duplicates.begin(), duplicates.end());
+	return duplicates;
+}
+
+std::vector<int> RemoveDuplicates(SearchServer& search_server) {
+	std::vector<int> duplicates = FindDuplicates(search_server);
+	search_server.RemoveDocuments(duplicates);
+	return duplicates;
+}
+
+std::vector<int> FindNearDuplicates(const SearchServer& search_server, const NearDuplicateOptions& options) {
+	if (!(options.jaccard_threshold > 0.0 && options.jaccard_threshold <= 1.0)) {
+		throw std::invalid_argument("Jaccard threshold must be in (0, 1]");
+	}
+	if (options.band_count == 0 || options.rows_per_band == 0) {
+		throw std::invalid_argument("MinHash signature must have at least one band and row");
+	}
+	const std::vector<int> document_ids(search_server.begin(), search_server.end());
+	if (document_ids.size() > std::numeric_limits<uint32_t>::max()) {
+		throw std::invalid_argument("Too many documents for near-duplicate detection");
+	}
+	ThreadPool& thread_pool = search_server.GetThreadPool();
+	constexpr size_t MIN_DOCUMENTS_PER_PART = 1024;
+	const size_t part_count = std::clamp<size_t>(document_ids.size() / MIN_DOCUMENTS_PER_PART,
+		1, thread_pool.GetConcurrency());
+	const std::vector<MinHashFunction> functions = MakeMinHashFunctions(
+		options.band_count * options.rows_per_band, options.seed);
+
+	// Каждый поток считает подписи своей части документов и раскладывает ключи полос
+	// по группам, как в FindDuplicates. Документы с одинаковым ключом попадают в одну группу
+	std::vector<std::vector<std::vector<BandedDocument>>> part_groups(part_count,
+		std::vector<std::vector<BandedDocument>>(part_count));
+	thread_pool.ParallelFor(part_count, [&](size_t part) {
+		const size_t first = document_ids.size() * part / part_count;
+		const size_t last = document_ids.size() * (part + 1) / part_count;
+		std::vector<uint32_t> signature(functions.size());
+		for (size_t i = first; i < last; ++i) {
+			const auto& terms = search_server.GetDocumentTerms(document_ids[i]);
+			if (terms.empty()) {
+				continue;
+			}
+			std::fill(signature.begin(), signature.end(), std::numeric_limits<uint32_t>::max());
+			for (const auto& [term_id, tf] : terms) {
+				const uint64_t term_hash = Mix(term_id);
+				for (size_t j = 0; j < functions.size(); ++j) {
+					signature[j] = std::min(signature[j], functions[j](term_hash));
+				}
+			}
+			for (size_t band = 0; band < options.band_count; ++band) {
+				uint64_t band_key = Mix(band + 1);
+				for (size_t row = 0; row < options.rows_per_band; ++row) {
+					band_key = Mix(band_key * 0x9e3779b97f4a7c15ULL + signature[band * options.rows_per_band + row]);
+				}
+				part_groups[part][band_key % part_count].push_back({band_key, static_cast<uint32_t>(i)});
+			}
+		}
+	});
+
+	// В серии одинаковых ключей документ становится кандидатом в пару с несколькими
+	// первыми документами серии: у них меньшие id, и они скорее всего остаются.
+	// Ограничение не дает огромным сериям одинаковых документов породить квадратичное
+	// число пар, а похожие документы обычно совпадают и в других полосах
+	constexpr size_t MAX_CANDIDATES_PER_BAND = 8;
+	std::vector<std::vector<CandidatePair>> group_candidates(part_count);
+	thread_pool.ParallelFor(part_count, [&](size_t group) {
+		std::vector<BandedDocument> documents;
+		for (const auto& groups : part_groups) {
+			documents.insert(documents.end(), groups[group].begin(), groups[group].end());
+		}
+		std::sort(documents.begin(), documents.end());
+		size_t run_begin = 0;
+		for (size_t i = 0; i < documents.size(); ++i) {
+			if (i > 0 && documents[i - 1].band_key != documents[i].band_key) {
+				run_begin = i;
+			}
+			for (size_t j = run_begin; j < std::min(i, run_begin + MAX_CANDIDATES_PER_BAND); ++j) {
+				group_candidates[group].push_back({documents[i].index, documents[j].index});
+			}
+		}
+	});
+
+	std::vector<CandidatePair> candidates;
+	for (const std::vector<CandidatePair>& group : group_candidates) {
+		candidates.insert(candidates.end(), group.begin(), group.end());
+	}
+	std::sort(candidates.begin(), candidates.end());
+	candidates.erase(std::unique(candidates.begin(), candidates.end()), candidates.end());
+
+	// Точная проверка кандидатов не зависит от порядка и выполняется параллельно
+	std::vector<char> is_similar(candidates.size());
+	thread_pool.ParallelFor(part_count, [&](size_t part) {
+		const size_t first = candidates.size() * part / part_count;
+		const size_t last = candidates.size() * (part + 1) / part_count;
+		for (size_t i = first; i < last; ++i) {
+			const auto& [duplicate, original] = candidates[i];
+			is_similar[i] = ComputeJaccard(search_server.GetDocumentTerms(document_ids[duplicate]),
+				search_server.GetDocumentTerms(document_ids[original])) >= options.jaccard_threshold;
+		}
+	});
+
+	// Пары упорядочены по почти дубликату, поэтому судьба документа с меньшим id
+	// известна к моменту проверки пары
+	std::vector<char> is_removed(document_ids.size(), false);
+	std::vector<int> duplicates;
+	for (size_t i = 0; i < candidates.size(); ++i) {
+		const auto& [duplicate, original] = candidates[i];
+		if (is_similar[i] && !is_removed[duplicate] && !is_removed[original]) {
+			is_removed[duplicate] = true;
+			duplicates.push_back(document_ids[duplicate]);
+		}
+	}
+	return duplicates;
+}
+
+std::vector<int> RemoveNearDuplicates(SearchServer& search_server, const NearDuplicateOptions& options) {
+	std::vector<int> duplicates = FindNearDuplicates(search_server, options);
+	search_server.RemoveDocuments(duplicates);
+	return duplicates;
 }
@@ -1,5 +1,38 @@
 #pragma once
 
+#include <cstdint>
+#include <vector>
 #include "search_server.h"
 
-void RemoveDuplicates(SearchServer& search_server);
+// Возвращает по возрастанию id документов, набор слов которых совпадает с набором слов
+// документа с меньшим id. Отпечатки наборов слов считаются параллельно на пуле потоков
+// сервера, совпадения отпечатков проверяются точным сравнением наборов
+std::vector<int> FindDuplicates(const SearchServer& search_server);
+
+// Удаляет дубликаты, найденные FindDuplicates, одним пакетом и возвращает их id
+std::vector<int> RemoveDuplicates(SearchServer& search_server);
+
+// Параметры поиска почти дубликатов. Подпись MinHash документа состоит из
+// band_count * rows_per_band значений. Пара документов с мерой Жаккара s становится
+// кандидатом с вероятностью 1 - (1 - s^rows_per_band)^band_count, поэтому порог
+// кривой примерно равен (1 / band_count)^(1 / rows_per_band) и должен быть ниже
+// jaccard_threshold. Кандидаты проверяются точной мерой Жаккара
+struct NearDuplicateOptions {
+	double jaccard_threshold = 0.8;
+	size_t band_count = 16;
+	size_t rows_per_band = 8;
+	uint64_t seed = 0;
+};
+
+// Возвращает по возрастанию id документов, мера Жаккара наборов слов которых с одним из
+// оставляемых документов с меньшим id не меньше порога. Документ, найденный почти дубликатом,
+// сам не делает почти дубликатами другие документы. Подписи считаются параллельно, а сравниваются
+// только документы, совпавшие хотя бы в одной полосе подписи (LSH), поэтому время растет
+// почти линейно с числом документов. Документы без слов пропускаются.
+// Недопустимые параметры вызывают исключение std::invalid_argument
+std::vector<int> FindNearDuplicates(const SearchServer& search_server,
+	const NearDuplicateOptions& options = NearDuplicateOptions{});
+
+// Удаляет почти дубликаты, найденные FindNearDuplicates, одним пакетом и возвращает их id
+std::vector<int> RemoveNearDuplicates(SearchServer& search_server,
+	const NearDuplicateOptions& options = NearDuplicateOptions{});
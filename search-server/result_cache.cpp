@@ -0,0 +1,100 @@
+#include "result_cache.h"
+
+#include <algorithm>
+#include <functional>
+#include <iterator>
+#include <stdexcept>
+
+ResultCache::ResultCache(size_t capacity, size_t shard_count)
+	: capacity_(capacity)
+	, shard_capacity_(0)
+	, shards_(std::max<size_t>(shard_count, 1))
+{
+	if (capacity == 0) {
+		throw std::invalid_argument("Result cache capacity must be positive");
+	}
+	shard_capacity_ = (capacity + shards_.size() - 1) / shards_.size();
+}
+
+ResultCache::ResultCache(const ResultCache & other)
+	: ResultCache(other.capacity_, other.shards_.size())
+{}
+
+ResultCache & ResultCache::operator=(const ResultCache & other) {
+	if (this != &other) {
+		capacity_ = other.capacity_;
+		shard_capacity_ = other.shard_capacity_;
+		shards_ = std::vector<Shard>(other.shards_.size());
+		hits_ = 0;
+		misses_ = 0;
+	}
+	return *this;
+}
+
+bool ResultCache::Find(const std::string & key, uint64_t generation, std::vector<Document> & documents) {
+	Shard & shard = GetShard(key);
+	std::lock_guard guard(shard.mutex);
+	const auto it = shard.positions.find(key);
+	if (it == shard.positions.end()) {
+		++misses_;
+		return false;
+	}
+	const auto entry = it->second;
+	if (entry->generation != generation) {
+		shard.positions.erase(it);
+		shard.entries.erase(entry);
+		++misses_;
+		return false;
+	}
+	shard.entries.splice(shard.entries.begin(), shard.entries, entry);
+	++hits_;
+	// Присваивание переиспользует память documents
+	documents = entry->documents;
+	return true;
+}
+
+void ResultCache::Insert(std::string_view key, uint64_t generation, const std::vector<Document> & documents) {
+	Shard & shard = GetShard(key);
+	std::lock_guard guard(shard.mutex);
+	if (const auto it = shard.positions.find(key); it != shard.positions.end()) {
+		// Тот же запрос мог быть посчитан параллельно, остается последний результат
+		const auto entry = it->second;
+		entry->generation = generation;
+		entry->documents = documents;
+		shard.entries.splice(shard.entries.begin(), shard.entries, entry);
+		return;
+	}
+	if (shard.entries.size() < shard_capacity_) {
+		shard.entries.push_front({std::string(key), generation, documents});
+		shard.positions.emplace(shard.entries.front().key, shard.entries.begin());
+		return;
+	}
+	// Узел списка, строка, вектор и узел словаря вытесняемой записи достаются новой
+	shard.entries.splice(shard.entries.begin(), shard.entries, std::prev(shard.entries.end()));
+	Entry & entry = shard.entries.front();
+	auto position = shard.positions.extract(entry.key);
+	entry.key.assign(key);
+	entry.generation = generation;
+	entry.documents = documents;
+	position.key() = entry.key;
+	shard.positions.insert(std::move(position));
+}
+
+size_t ResultCache::GetCapacity() const {
+	return capacity_;
+}
+
+ResultCache::Stats ResultCache::GetStats() const {
+	Stats stats;
+	stats.hits = hits_;
+	stats.misses = misses_;
+	for (const Shard & shard : shards_) {
+		std::lock_guard guard(shard.mutex);
+		stats.size += shard.entries.size();
+	}
+	return stats;
+}
+
+ResultCache::Shard & ResultCache::GetShard(std::string_view key) {
+	return shards_[std::hash<std::string_view>{}(key) % shards_.size()];
+}
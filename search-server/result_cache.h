@@ -0,0 +1,65 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <list>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+#include "document.h"
+
+// Ограниченный кэш результатов поиска с вытеснением давно не использованных записей (LRU).
+// Записи распределены по частям с собственными мьютексами, поэтому параллельные запросы
+// редко ждут друг друга. Каждая запись помнит поколение индекса, при котором она посчитана:
+// запись другого поколения считается устаревшей и удаляется при обращении
+class ResultCache {
+public:
+	static constexpr size_t DEFAULT_SHARD_COUNT = 16;
+
+	struct Stats {
+		size_t hits = 0;
+		size_t misses = 0;
+		// Число записей в кэше, включая еще не удаленные устаревшие
+		size_t size = 0;
+	};
+
+	// capacity - наибольшее общее число записей, делится между shard_count частями поровну
+	explicit ResultCache(size_t capacity, size_t shard_count = DEFAULT_SHARD_COUNT);
+	// Копия получает те же размеры, но пуста и со сброшенными счетчиками
+	ResultCache(const ResultCache & other);
+	ResultCache & operator=(const ResultCache & other);
+
+	// Копирует в documents результат, сохраненный для key в поколении generation.
+	// Возвращает false, если такого результата нет
+	bool Find(const std::string & key, uint64_t generation, std::vector<Document> & documents);
+	// Запоминает documents для key. Вытесняемая запись переиспользуется вместе с памятью
+	// ключа и результата, поэтому в заполненном кэше вставка обычно не выделяет память
+	void Insert(std::string_view key, uint64_t generation, const std::vector<Document> & documents);
+
+	size_t GetCapacity() const;
+	Stats GetStats() const;
+
+private:
+	struct Entry {
+		std::string key;
+		uint64_t generation;
+		std::vector<Document> documents;
+	};
+	struct Shard {
+		mutable std::mutex mutex;
+		// Начало списка - последняя использованная запись
+		std::list<Entry> entries;
+		// Ключи указывают на строки записей списка
+		std::unordered_map<std::string_view, std::list<Entry>::iterator> positions;
+	};
+
+	size_t capacity_;
+	size_t shard_capacity_;
+	std::vector<Shard> shards_;
+	std::atomic<size_t> hits_{0};
+	std::atomic<size_t> misses_{0};
+
+	Shard & GetShard(std::string_view key);
+};
@@ -0,0 +1,56 @@
+#include "score_accumulator.h"
+
+#include <algorithm>
+
+void ScoreAccumulator::Reset(DocumentOrdinal first_ordinal, DocumentOrdinal last_ordinal) {
+	first_ordinal_ = first_ordinal;
+	const size_t ordinal_count = last_ordinal - first_ordinal;
+	if (scores_.size() < ordinal_count) {
+		scores_.resize(ordinal_count, 0.0);
+		states_.resize(ordinal_count, State::UNTOUCHED);
+	}
+}
+
+void ScoreAccumulator::SortTouched() {
+	std::sort(touched_.begin(), touched_.end());
+}
+
+void ScoreAccumulator::Clear() {
+	for (DocumentOrdinal ordinal : touched_) {
+		scores_[ordinal] = 0.0;
+		states_[ordinal] = State::UNTOUCHED;
+	}
+	touched_.clear();
+}
+
+ScoreAccumulatorPool::Handle::Handle(std::unique_ptr<ScoreAccumulator> accumulator)
+	: accumulator_(std::move(accumulator)) {}
+
+ScoreAccumulatorPool::Handle::~Handle() {
+	if (accumulator_) {
+		accumulator_->Clear();
+		LocalPool().push_back(std::move(accumulator_));
+	}
+}
+
+ScoreAccumulatorPool::Handle ScoreAccumulatorPool::Acquire(DocumentOrdinal first_ordinal,
+	DocumentOrdinal last_ordinal)
+{
+	auto & pool = LocalPool();
+	std::unique_ptr<ScoreAccumulator> accumulator;
+	if (pool.empty()) {
+		accumulator = std::make_unique<ScoreAccumulator>();
+	} else {
+		accumulator = std::move(pool.back());
+		pool.pop_back();
+	}
+	accumulator->Reset(first_ordinal, last_ordinal);
+	return Handle(std::move(accumulator));
+}
+
+std::vector<std::unique_ptr<ScoreAccumulator>> & ScoreAccumulatorPool::LocalPool() {
+	// В пуле может быть несколько аккумуляторов, чтобы вложенный запрос
+	// (например, из фильтра) не делил буфер с внешним
+	thread_local std::vector<std::unique_ptr<ScoreAccumulator>> pool;
+	return pool;
+}
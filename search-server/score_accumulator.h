@@ -0,0 +1,114 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+#include "document.h"
+
+// Плотный аккумулятор релевантности запроса для документов с номерами из [first, last).
+// Счета хранятся в массиве по номеру документа, а список затронутых номеров
+// позволяет обойти и очистить только реально задетые ячейки
+class ScoreAccumulator {
+public:
+	// Настраивает аккумулятор на номера [first_ordinal, last_ordinal), при необходимости увеличивая массивы
+	void Reset(DocumentOrdinal first_ordinal, DocumentOrdinal last_ordinal);
+
+	void Add(DocumentOrdinal ordinal, double score) {
+		const DocumentOrdinal index = ordinal - first_ordinal_;
+		if (states_[index] == State::UNTOUCHED) {
+			states_[index] = State::SCORED;
+			touched_.push_back(index);
+		}
+		if (states_[index] == State::SCORED) {
+			scores_[index] += score;
+		}
+	}
+
+	// Исключает документ из результата. Последующие Add для него игнорируются
+	void Exclude(DocumentOrdinal ordinal) {
+		const DocumentOrdinal index = ordinal - first_ordinal_;
+		if (states_[index] == State::UNTOUCHED) {
+			touched_.push_back(index);
+		}
+		states_[index] = State::EXCLUDED;
+	}
+
+	bool IsExcluded(DocumentOrdinal ordinal) const {
+		return states_[ordinal - first_ordinal_] == State::EXCLUDED;
+	}
+
+	// Вызывает function(ordinal, relevance) для всех набравших счет и не исключенных документов
+	template <typename Function>
+	void ForEach(Function function) const {
+		for (DocumentOrdinal index : touched_) {
+			if (states_[index] == State::SCORED) {
+				function(first_ordinal_ + index, scores_[index]);
+			}
+		}
+	}
+
+	// То же для документов с номерами из [first, last), но по возрастанию номеров. Просматривает
+	// все ячейки отрезка, поэтому выгоднее сортировки, когда затронута заметная их доля
+	template <typename Function>
+	void ForEachInRange(DocumentOrdinal first, DocumentOrdinal last, Function function) const {
+		for (DocumentOrdinal index = first - first_ordinal_; index < last - first_ordinal_; ++index) {
+			if (states_[index] == State::SCORED) {
+				function(first_ordinal_ + index, scores_[index]);
+			}
+		}
+	}
+
+	// Число затронутых документов, включая исключенные
+	size_t GetTouchedCount() const {
+		return touched_.size();
+	}
+
+	// Упорядочивает затронутые документы, после чего ForEach обходит их по возрастанию номеров
+	void SortTouched();
+
+	// Обнуляет только затронутые ячейки
+	void Clear();
+
+private:
+	enum class State : uint8_t {
+		UNTOUCHED,
+		SCORED,
+		EXCLUDED
+	};
+
+	DocumentOrdinal first_ordinal_ = 0;
+	std::vector<double> scores_;
+	std::vector<State> states_;
+	// смещения от first_ordinal_
+	std::vector<DocumentOrdinal> touched_;
+};
+
+// Пул аккумуляторов, свой у каждого потока.
+// Буферы переживают запрос, поэтому в установившемся режиме запрос не выделяет память
+class ScoreAccumulatorPool {
+public:
+	// Возвращает аккумулятор в пул при разрушении
+	class Handle {
+	public:
+		explicit Handle(std::unique_ptr<ScoreAccumulator> accumulator);
+		Handle(Handle && other) = default;
+		Handle & operator=(Handle && other) = delete;
+		~Handle();
+
+		ScoreAccumulator & operator*() const {
+			return *accumulator_;
+		}
+		ScoreAccumulator * operator->() const {
+			return accumulator_.get();
+		}
+
+	private:
+		std::unique_ptr<ScoreAccumulator> accumulator_;
+	};
+
+	// Выдает чистый аккумулятор для номеров документов [first_ordinal, last_ordinal)
+	static Handle Acquire(DocumentOrdinal first_ordinal, DocumentOrdinal last_ordinal);
+
+private:
+	static std::vector<std::unique_ptr<ScoreAccumulator>> & LocalPool();
+};
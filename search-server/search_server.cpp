@@ -1,9 +1,10 @@
 #include "search_server.h"
-#include "concurrent_map.h"
+#include "snapshot.h"
 #include <numeric>
 #include <cmath>
 #include <algorithm>
-#include <mutex>
+#include <cstring>
+#include <atomic>
 
 using std::literals::string_literals::operator""s;
 
@@ -21,45 +22,116 @@ void SearchServer::AddDocument(int document_id, std::string_view document,
 	if (document_id < 0) {
 		throw std::invalid_argument("Id less then zero");
 	}
-	if (documents_info_.count(document_id)) {
+	if (documents_.Contains(document_id)) {
 		throw std::invalid_argument("Document with this id already exists");
 	}
 
-	storage_.emplace_back(document);
-	const std::vector<std::string_view> words = SplitIntoWordsNoStop(storage_.back());
-	if (!IsValidAllWords(words)) {
-		storage_.pop_back();
+	// Текст документа нужен только на время разбора: слова хранятся в словаре индекса
+	std::vector<std::string_view> words;
+	if (!SplitIntoWordsNoStop(document, words)) {
 		throw std::invalid_argument("Document contain special characters");
 	}
 	documents_id_.insert(document_id);
 
-	documents_info_[document_id] = {ComputeAverageRating(ratings), status, {}};
 	double tf_coeff = 1.0 / static_cast<double>(words.size());
+	std::vector<InvertedIndex::TermFrequency> term_frequencies;
+	term_frequencies.reserve(words.size());
 	for(const auto & word : words) {
-		documents_with_tf_[word][document_id] += tf_coeff;
-		documents_info_[document_id].words[word] += tf_coeff;
+		term_frequencies.push_back({index_.AddTerm(word), tf_coeff});
+	}
+	const DocumentOrdinal ordinal = AcquireOrdinal(document_id, ComputeAverageRating(ratings), status,
+		static_cast<uint32_t>(words.size()), MakeDocumentTerms(std::move(term_frequencies)));
+	for (const auto & [term_id, tf] : documents_.GetTerms(ordinal)) {
+		index_.AddPosting(term_id, ordinal, tf);
+	}
+}
+
+void SearchServer::AddDocuments(const std::vector<DocumentRecord> & documents) {
+	// Все проверки выполняются до публикации документов
+	std::vector<int> new_ids;
+	new_ids.reserve(documents.size());
+	for (const DocumentRecord & document : documents) {
+		if (document.id < 0) {
+			throw std::invalid_argument("Id less then zero");
+		}
+		if (documents_.Contains(document.id)) {
+			throw std::invalid_argument("Document with this id already exists");
+		}
+		new_ids.push_back(document.id);
+	}
+	std::sort(new_ids.begin(), new_ids.end());
+	if (std::adjacent_find(new_ids.begin(), new_ids.end()) != new_ids.end()) {
+		throw std::invalid_argument("Document with this id already exists");
+	}
+
+	std::vector<std::vector<std::string_view>> document_words(documents.size());
+	std::vector<char> is_valid(documents.size());
+	thread_pool_->ParallelFor(documents.size(), [&](size_t i) {
+		is_valid[i] = SplitIntoWordsNoStop(documents[i].text, document_words[i]);
+	});
+	if (std::find(is_valid.begin(), is_valid.end(), false) != is_valid.end()) {
+		throw std::invalid_argument("Document contain special characters");
+	}
+
+	// Словарь меняется в одном потоке, а упорядочивание слов документов - снова параллельно
+	std::vector<std::vector<InvertedIndex::TermFrequency>> document_terms(documents.size());
+	for (size_t i = 0; i < documents.size(); ++i) {
+		const double tf_coeff = 1.0 / static_cast<double>(document_words[i].size());
+		document_terms[i].reserve(document_words[i].size());
+		for (const std::string_view word : document_words[i]) {
+			document_terms[i].push_back({index_.AddTerm(word), tf_coeff});
+		}
 	}
+	thread_pool_->ParallelFor(documents.size(), [&](size_t i) {
+		document_terms[i] = MakeDocumentTerms(std::move(document_terms[i]));
+	});
+
+	// Номера документов пакета идут подряд после уже выданных, поэтому
+	// вхождения дописываются в конец списков без поиска места вставки
+	std::vector<InvertedIndex::TermPosting> term_postings;
+	for (size_t i = 0; i < documents.size(); ++i) {
+		const DocumentOrdinal ordinal = AcquireOrdinal(documents[i].id,
+			ComputeAverageRating(documents[i].ratings), documents[i].status,
+			static_cast<uint32_t>(document_words[i].size()), std::move(document_terms[i]));
+		for (const auto & [term_id, tf] : documents_.GetTerms(ordinal)) {
+			term_postings.push_back({term_id, {ordinal, tf}});
+		}
+		documents_id_.insert(documents[i].id);
+	}
+	index_.AppendPostings(term_postings);
 }
 
 std::vector<Document> SearchServer::FindTopDocuments(std::string_view raw_query,
 	DocumentStatus status) const
 {
-	return FindTopDocuments(raw_query,
-		[status](int, DocumentStatus document_status, int) {
-			return document_status == status;
-		});
+	return FindTopDocuments(raw_query, status, SearchOptions{});
+}
+
+std::vector<Document> SearchServer::FindTopDocuments(std::string_view raw_query,
+	DocumentStatus status, const SearchOptions & options) const
+{
+	return FindTopDocuments(std::execution::seq, raw_query, status, options);
+}
+
+const std::vector<Document> & SearchServer::FindTopDocuments(QueryContext & context,
+	std::string_view raw_query, DocumentStatus status, const SearchOptions & options) const
+{
+	FindTopDocumentsByStatus(std::execution::seq, context, raw_query, status, options);
+	return context.results_;
 }
 
 SearchServer::MatchedDocuments SearchServer::MatchDocument(
 	std::string_view raw_query, int document_id) const
 {
-	DocumentStatus result_status = documents_info_.at(document_id).status;
+	const DocumentOrdinal ordinal = documents_.GetOrdinal(document_id);
+	const DocumentTable::Terms & terms = documents_.GetTerms(ordinal);
+	DocumentStatus result_status = documents_.GetStatus(ordinal);
 
 	const Query query_words = ParseQuery(raw_query);
 
 	bool need_check_plus_words = true;
 	for (const std::string_view minus_word : query_words.minus_words) {
-		if (HasWordInDocument(minus_word, document_id)) {
+		if (HasWordInDocument(minus_word, terms)) {
 			need_check_plus_words = false;
 			break;
 		}
@@ -68,8 +140,9 @@ SearchServer::MatchedDocuments SearchServer::MatchDocument(
 	std::vector<std::string_view> matched_words;
 	if (need_check_plus_words) {
 		for (const std::string_view plus_word : query_words.plus_words) {
-			if (HasWordInDocument(plus_word, document_id)) {
-				matched_words.push_back((*documents_info_.at(document_id).words.find(plus_word)).first);
+			const auto term_id = index_.FindTerm(plus_word);
+			if (term_id && HasTermInDocument(*term_id, terms)) {
+				matched_words.push_back(index_.GetTerm(*term_id));
 			}
 		}
 		std::sort(matched_words.begin(), matched_words.end());
@@ -89,13 +162,15 @@ SearchServer::MatchedDocuments SearchServer::MatchDocument(
 	const std::execution::parallel_policy & par,
 	std::string_view raw_query, int document_id) const
 {
-	DocumentStatus result_status = documents_info_.at(document_id).status;
+	const DocumentOrdinal ordinal = documents_.GetOrdinal(document_id);
+	const DocumentTable::Terms & terms = documents_.GetTerms(ordinal);
+	DocumentStatus result_status = documents_.GetStatus(ordinal);
 	Query query_words = ParseQuery(raw_query, false);
 
 	bool need_check_plus_words = std::none_of(par,
 		query_words.minus_words.begin(), query_words.minus_words.end(),
 		[&](auto & minus_word){
-			return HasWordInDocument(minus_word, document_id);
+			return HasWordInDocument(minus_word, terms);
 		});
 
 	std::vector<std::string_view> matched_words;
@@ -105,12 +180,13 @@ SearchServer::MatchedDocuments SearchServer::MatchDocument(
 			query_words.plus_words.begin(), query_words.plus_words.end(),
 			matched_words.begin(),
 			[&](auto plus_word){
-				return HasWordInDocument(plus_word, document_id);
+				return HasWordInDocument(plus_word, terms);
 			});
 		matched_words.erase(last, matched_words.end());
+		// Слова запроса заменяются строками словаря, которые переживают запрос
 		std::transform(matched_words.begin(), matched_words.end(), matched_words.begin(),
 			[&](std::string_view word){
-				return (*documents_info_.at(document_id).words.find(word)).first;
+				return index_.GetTerm(*index_.FindTerm(word));
 			});
         SortAndRemoveDuplicates(std::execution::par, matched_words);
 	}
@@ -119,7 +195,7 @@ SearchServer::MatchedDocuments SearchServer::MatchDocument(
 }
 
 int SearchServer::GetDocumentCount() const {
-	return static_cast<int>(documents_info_.size());
+	return static_cast<int>(documents_.GetDocumentCount());
 }
 
 std::set<int>::const_iterator SearchServer::begin() const {
@@ -130,28 +206,102 @@ std::set<int>::const_iterator SearchServer::end() const {
 	return documents_id_.end();
 }
 
+const std::vector<InvertedIndex::TermFrequency> & SearchServer::GetDocumentTerms(int document_id) const {
+	static const std::vector<InvertedIndex::TermFrequency> empty_terms;
+	const auto ordinal = documents_.FindOrdinal(document_id);
+	if (!ordinal) {
+		return empty_terms;
+	}
+	return documents_.GetTerms(*ordinal);
+}
+
+std::string_view SearchServer::GetTerm(InvertedIndex::TermId term_id) const {
+	return index_.GetTerm(term_id);
+}
+
+size_t SearchServer::GetTermCount() const {
+	return index_.GetTermCount();
+}
+
 const std::map<std::string_view, double> & SearchServer::GetWordFrequencies(int document_id) const {
 	static const std::map<std::string_view, double> empty_words;
-	if (!documents_info_.count(document_id)) {
+	const auto ordinal = documents_.FindOrdinal(document_id);
+	if (!ordinal) {
 		return empty_words;
 	}
-	return documents_info_.at(document_id).words;
+	struct Entry {
+		uint64_t state_id = 0;
+		int document_id = 0;
+		std::map<std::string_view, double> words;
+	};
+	// Записи вытесняются по кругу. Узлы вытесняемого словаря переиспользуются для нового
+	thread_local std::array<Entry, WORD_FREQUENCY_CACHE_SIZE> entries;
+	thread_local size_t next_entry = 0;
+	thread_local std::vector<std::map<std::string_view, double>::node_type> nodes;
+	for (const Entry & entry : entries) {
+		if (entry.state_id == state_id_.Get() && entry.document_id == document_id) {
+			return entry.words;
+		}
+	}
+	Entry & entry = entries[next_entry];
+	next_entry = (next_entry + 1) % entries.size();
+	// Строки старого словаря могли быть освобождены, поэтому узлы вынимаются без сравнения ключей
+	while (!entry.words.empty()) {
+		nodes.push_back(entry.words.extract(entry.words.begin()));
+	}
+	entry.state_id = state_id_.Get();
+	entry.document_id = document_id;
+	for (const auto & [term_id, tf] : documents_.GetTerms(*ordinal)) {
+		if (nodes.empty()) {
+			entry.words.emplace(index_.GetTerm(term_id), tf);
+			continue;
+		}
+		nodes.back().key() = index_.GetTerm(term_id);
+		nodes.back().mapped() = tf;
+		entry.words.insert(std::move(nodes.back()));
+		nodes.pop_back();
+	}
+	return entry.words;
+}
+
+SearchServer::StateId::StateId()
+	: value_(0)
+{
+	Update();
+}
+
+SearchServer::StateId::StateId(const StateId &)
+	: StateId()
+{}
+
+SearchServer::StateId & SearchServer::StateId::operator=(const StateId &) {
+	Update();
+	return *this;
+}
+
+void SearchServer::StateId::Update() {
+	// Нулевой номер не выдается: им помечены пустые записи словарей
+	static std::atomic<uint64_t> next_value{1};
+	value_ = next_value.fetch_add(1, std::memory_order_relaxed);
 }
 
 void SearchServer::RemoveDocument(int document_id) {
 	documents_id_.erase(document_id);
-	if (documents_info_.count(document_id)) {
-		std::vector<std::string_view> words_without_document;
-		for (auto [word, tf] : documents_info_.at(document_id).words) {
-			documents_with_tf_.at(word).erase(document_id);
-			if (documents_with_tf_.at(word).empty()) {
-				words_without_document.push_back(word);
+	state_id_.Update();
+	if (const auto ordinal = documents_.FindOrdinal(document_id)) {
+		// Прямой индекс забирается до освобождения номера, которое его очищает
+		const DocumentTable::Terms terms = std::move(documents_.GetTerms(*ordinal));
+		ReleaseOrdinal(*ordinal);
+		const auto is_live = [this](DocumentOrdinal ordinal) {
+			return documents_.GetId(ordinal) >= 0;
+		};
+		// Слова остаются в словаре индекса, даже если документов с ними больше нет.
+		// Список очищается от удаленных вхождений, когда их в нем больше, чем живых
+		for (const auto & [term_id, tf] : terms) {
+			if (index_.MarkPostingRemoved(term_id)) {
+				index_.PurgeRemovedPostings(term_id, is_live);
 			}
 		}
-		for (auto word : words_without_document) {
-			documents_with_tf_.erase(word);
-		}
-		documents_info_.erase(document_id);
 	}
 }
 
@@ -159,47 +309,247 @@ void SearchServer::RemoveDocument([[maybe_unused]] const std::execution::sequenc
 	RemoveDocument(document_id);
 }
 
-void SearchServer::RemoveDocument(const std::execution::parallel_policy & par, int document_id) {
-	documents_id_.erase(document_id);
-	if (documents_info_.count(document_id)) {
-		std::vector<std::string_view> words_in_document(documents_info_.at(document_id).words.size());
-		std::transform(par,
-			documents_info_.at(document_id).words.begin(),
-			documents_info_.at(document_id).words.end(),
-			words_in_document.begin(),
-			[](const auto word_with_tf){
-				return word_with_tf.first;
-			});
-		std::vector<std::string_view> words_without_document;
-		words_without_document.reserve(words_in_document.size());
-		std::mutex empty_word_mutex;
-		std::for_each(par, words_in_document.begin(), words_in_document.end(),
-			[&](std::string_view word){
-				documents_with_tf_.at(word).erase(document_id);
-				if (documents_with_tf_.at(word).empty()) {
-					std::lock_guard guard(empty_word_mutex);
-					words_without_document.push_back(word);
-				}
-			});
-		for (auto word : words_without_document) {
-			documents_with_tf_.erase(word);
+void SearchServer::RemoveDocument([[maybe_unused]] const std::execution::parallel_policy & par,
+	int document_id)
+{
+	// Удаление только обновляет счетчики слов документа, делить такую работу
+	// между потоками дороже, чем выполнить ее
+	RemoveDocument(document_id);
+}
+
+void SearchServer::RemoveDocuments(const std::vector<int> & document_ids) {
+	std::vector<DocumentOrdinal> ordinals;
+	ordinals.reserve(document_ids.size());
+	for (const int document_id : document_ids) {
+		if (const auto ordinal = documents_.FindOrdinal(document_id)) {
+			ordinals.push_back(*ordinal);
+		}
+	}
+	std::sort(ordinals.begin(), ordinals.end());
+	ordinals.erase(std::unique(ordinals.begin(), ordinals.end()), ordinals.end());
+
+	// Прямой индекс документа забирается из таблицы и освобождается сразу после чтения,
+	// пока он в кэше
+	std::vector<InvertedIndex::TermId> purge_terms;
+	for (const DocumentOrdinal ordinal : ordinals) {
+		const DocumentTable::Terms terms = std::move(documents_.GetTerms(ordinal));
+		for (const auto & [term_id, tf] : terms) {
+			if (index_.MarkPostingRemoved(term_id)) {
+				purge_terms.push_back(term_id);
+			}
+		}
+	}
+
+	std::vector<int> removed_ids;
+	removed_ids.reserve(ordinals.size());
+	for (const DocumentOrdinal ordinal : ordinals) {
+		removed_ids.push_back(documents_.GetId(ordinal));
+	}
+	// Соседние по порядку id ищутся по уже прогретым в кэше узлам дерева
+	std::sort(removed_ids.begin(), removed_ids.end());
+	for (const int document_id : removed_ids) {
+		documents_id_.erase(document_id);
+	}
+	state_id_.Update();
+	ReleaseOrdinals(ordinals);
+	// Списки очищаются по таблице документов, поэтому после освобождения номеров
+	const auto is_live = [this](DocumentOrdinal ordinal) {
+		return documents_.GetId(ordinal) >= 0;
+	};
+	for (const InvertedIndex::TermId term_id : purge_terms) {
+		index_.PurgeRemovedPostings(term_id, is_live);
+	}
+}
+
+bool SearchServer::NeedsCompaction() const {
+	// Сжатие проходит по всему индексу, поэтому окупается, когда удалена половина документов
+	return documents_.GetRemovedCount() > documents_.GetDocumentCount();
+}
+
+void SearchServer::Compact() {
+	CompactOrdinals();
+	PurgeEmptyTermsIfSparse();
+}
+
+void SearchServer::SaveSnapshot(const std::string & path) const {
+	SnapshotWriter writer(path);
+	writer.WriteBytes(SNAPSHOT_SIGNATURE, sizeof(SNAPSHOT_SIGNATURE));
+	writer.Write(SNAPSHOT_VERSION);
+	writer.Write(SNAPSHOT_BYTE_ORDER_MARK);
+
+	writer.Write(static_cast<uint64_t>(stop_words_.size()));
+	for (const std::string & word : stop_words_) {
+		writer.WriteString(word);
+	}
+
+	// Документы пишутся по порядку номеров, номера удаленных документов пропускаются
+	std::vector<DocumentOrdinal> new_ordinals(documents_.GetOrdinalCount(), PostingList::NO_ORDINAL);
+	DocumentOrdinal next_ordinal = 0;
+	writer.Write(static_cast<uint64_t>(documents_.GetDocumentCount()));
+	for (DocumentOrdinal ordinal = 0; ordinal < documents_.GetOrdinalCount(); ++ordinal) {
+		const int document_id = documents_.GetId(ordinal);
+		if (document_id < 0) {
+			continue;
+		}
+		new_ordinals[ordinal] = next_ordinal++;
+		writer.Write(static_cast<int32_t>(document_id));
+		writer.Write(static_cast<int32_t>(documents_.GetRating(ordinal)));
+		writer.Write(static_cast<int32_t>(documents_.GetStatus(ordinal)));
+		writer.Write(documents_.GetLength(ordinal));
+	}
+
+	// Слова, у которых не осталось документов, и вхождения удаленных документов не сохраняются.
+	// Списки пишутся в сжатом виде, а при удаленных документах сначала перенумеровываются
+	const bool has_removed = next_ordinal != documents_.GetOrdinalCount();
+	uint64_t term_count = 0;
+	for (InvertedIndex::TermId term_id = 0; term_id < index_.GetTermCount(); ++term_id) {
+		term_count += index_.GetDocumentFrequency(term_id) == 0 ? 0 : 1;
+	}
+	writer.Write(term_count);
+	for (InvertedIndex::TermId term_id = 0; term_id < index_.GetTermCount(); ++term_id) {
+		const size_t document_frequency = index_.GetDocumentFrequency(term_id);
+		if (document_frequency == 0) {
+			continue;
+		}
+		writer.WriteString(index_.GetTerm(term_id));
+		if (has_removed) {
+			PostingList postings = index_.GetPostings(term_id);
+			postings.Remap(new_ordinals);
+			postings.Save(writer);
+		} else {
+			index_.GetPostings(term_id).Save(writer);
+		}
+	}
+	writer.Finish();
+}
+
+SearchServer SearchServer::LoadSnapshot(const std::string & path) {
+	SnapshotReader reader(path);
+	if (std::memcmp(reader.ReadArray<char>(sizeof(SNAPSHOT_SIGNATURE)), SNAPSHOT_SIGNATURE,
+		sizeof(SNAPSHOT_SIGNATURE)) != 0)
+	{
+		throw std::runtime_error("File is not a search server snapshot");
+	}
+	if (reader.Read<uint32_t>() != SNAPSHOT_VERSION) {
+		throw std::runtime_error("Unsupported snapshot version");
+	}
+	if (reader.Read<uint32_t>() != SNAPSHOT_BYTE_ORDER_MARK) {
+		throw std::runtime_error("Snapshot was written with another byte order");
+	}
+	const auto corrupted = [] {
+		return std::runtime_error("Snapshot is corrupted");
+	};
+
+	std::vector<std::string> stop_words;
+	const uint64_t stop_word_count = reader.Read<uint64_t>();
+	for (uint64_t i = 0; i < stop_word_count; ++i) {
+		stop_words.emplace_back(reader.ReadString());
+	}
+	SearchServer search_server(stop_words);
+
+	const uint64_t document_count = reader.Read<uint64_t>();
+	for (uint64_t i = 0; i < document_count; ++i) {
+		const int document_id = reader.Read<int32_t>();
+		const int rating = reader.Read<int32_t>();
+		const int32_t status = reader.Read<int32_t>();
+		const uint32_t length = reader.Read<uint32_t>();
+		if (document_id < 0 || search_server.documents_.Contains(document_id)
+			|| status < static_cast<int32_t>(DocumentStatus::ACTUAL)
+			|| status > static_cast<int32_t>(DocumentStatus::REMOVED))
+		{
+			throw corrupted();
 		}
-		documents_info_.erase(document_id);
+		search_server.AcquireOrdinal(document_id, rating, static_cast<DocumentStatus>(status), length, {});
+		search_server.documents_id_.insert(document_id);
+	}
+	DocumentTable & documents = search_server.documents_;
+
+	InvertedIndex & index = search_server.index_;
+	const uint64_t term_count = reader.Read<uint64_t>();
+	for (uint64_t i = 0; i < term_count; ++i) {
+		const std::string_view word = reader.ReadString();
+		PostingList postings = PostingList::Load(reader, static_cast<DocumentOrdinal>(document_count));
+		const InvertedIndex::TermId term_id = index.AddTerm(word);
+		if (postings.IsEmpty() || !index.GetPostings(term_id).IsEmpty()) {
+			throw corrupted();
+		}
+		index.AssignPostings(term_id, std::move(postings));
+	}
+	if (!reader.IsAtEnd()) {
+		throw corrupted();
+	}
+
+	// Прямой индекс восстанавливается по спискам вхождений. Слова обходятся по возрастанию id,
+	// поэтому списки слов документов сразу получаются упорядоченными
+	std::vector<size_t> term_counts(document_count, 0);
+	for (InvertedIndex::TermId term_id = 0; term_id < index.GetTermCount(); ++term_id) {
+		index.GetPostings(term_id).ForEach(0, PostingList::NO_ORDINAL, [&term_counts](DocumentOrdinal ordinal, double) {
+			++term_counts[ordinal];
+		});
+	}
+	for (DocumentOrdinal ordinal = 0; ordinal < document_count; ++ordinal) {
+		documents.GetTerms(ordinal).reserve(term_counts[ordinal]);
+	}
+	for (InvertedIndex::TermId term_id = 0; term_id < index.GetTermCount(); ++term_id) {
+		index.GetPostings(term_id).ForEach(0, PostingList::NO_ORDINAL, [&](DocumentOrdinal ordinal, double tf) {
+			documents.GetTerms(ordinal).push_back({term_id, tf});
+		});
+	}
+	return search_server;
+}
+
+void SearchServer::SetDocumentSet(const std::string & name, const std::vector<int> & document_ids) {
+	DocumentBitmap documents;
+	for (const int document_id : document_ids) {
+		const auto ordinal = documents_.FindOrdinal(document_id);
+		if (!ordinal) {
+			throw std::invalid_argument("Document with this id doesn't exist");
+		}
+		documents.Add(*ordinal);
+	}
+	document_sets_[name] = std::move(documents);
+	++generation_;
+}
+
+void SearchServer::RemoveDocumentSet(std::string_view name) {
+	if (auto it = document_sets_.find(name); it != document_sets_.end()) {
+		document_sets_.erase(it);
+		++generation_;
 	}
 }
 
+void SearchServer::EnableResultCache(size_t capacity, size_t shard_count) {
+	result_cache_.emplace(capacity, shard_count);
+}
+
+void SearchServer::DisableResultCache() {
+	result_cache_.reset();
+}
+
+ResultCache::Stats SearchServer::GetResultCacheStats() const {
+	return result_cache_ ? result_cache_->GetStats() : ResultCache::Stats{};
+}
+
+void SearchServer::SetThreadPool(ThreadPool & thread_pool) {
+	thread_pool_ = &thread_pool;
+}
+
+ThreadPool & SearchServer::GetThreadPool() const {
+	return *thread_pool_;
+}
+
 bool SearchServer::IsStopWord(std::string_view word) const {
 	return stop_words_.count(word) != 0;
 }
 
-std::vector<std::string_view> SearchServer::SplitIntoWordsNoStop(std::string_view text) const {
-	std::vector<std::string_view> words;
-	for (const std::string_view word : SplitIntoWordsView(text)) {
-		if (!IsStopWord(word)) {
-			words.push_back(word);
-		}
+bool SearchServer::SplitIntoWordsNoStop(std::string_view text, std::vector<std::string_view> & words) const {
+	if (!SplitIntoValidWordsView(text, words)) {
+		return false;
 	}
-	return words;
+	words.erase(std::remove_if(words.begin(), words.end(), [this](std::string_view word) {
+		return IsStopWord(word);
+	}), words.end());
+	return true;
 }
 
 SearchServer::QueryWord SearchServer::CheckWord(std::string_view word) const {
@@ -224,10 +574,20 @@ SearchServer::QueryWord SearchServer::CheckWord(std::string_view word) const {
 
 SearchServer::Query SearchServer::ParseQuery(std::string_view text, bool needSortAndUnique) const {
 	Query query;
-	for (std::string_view word : SplitIntoWordsView(text)) {
-		if (!IsValidWord(word)) {
-			throw std::invalid_argument("Query contain special characters");
-		}
+	std::vector<std::string_view> tokens;
+	ParseQuery(text, tokens, query, needSortAndUnique);
+	return query;
+}
+
+void SearchServer::ParseQuery(std::string_view text, std::vector<std::string_view> & tokens, Query & query,
+	bool needSortAndUnique) const
+{
+	query.plus_words.clear();
+	query.minus_words.clear();
+	if (!SplitIntoValidWordsView(text, tokens)) {
+		throw std::invalid_argument("Query contain special characters");
+	}
+	for (std::string_view word : tokens) {
 		QueryWord checked_word = CheckWord(word);
 		if (checked_word.is_stop) {
 			continue;
@@ -248,17 +608,274 @@ SearchServer::Query SearchServer::ParseQuery(std::string_view text, bool needSor
 		SortAndRemoveDuplicates(std::execution::seq, query.plus_words);
 		SortAndRemoveDuplicates(std::execution::seq, query.minus_words);
 	}
-	return query;
 }
 
-double SearchServer::CalcIdf(std::string_view word) const {
-	return std::log(static_cast<double>(documents_info_.size())
-		/ static_cast<double>(documents_with_tf_.at(word).size()));
+void SearchServer::MakeResultCacheKey(const Query & query, DocumentStatus status,
+	const SearchOptions & options, std::string & key)
+{
+	// Слова не содержат пробелов и управляющих символов, поэтому разделители однозначны.
+	// Имена множеств могут быть любыми и записываются с длиной
+	key.clear();
+	key += std::to_string(static_cast<int>(status));
+	key += ' ';
+	key += std::to_string(options.top_k);
+	for (const std::string & name : options.document_sets) {
+		key += ' ';
+		key += std::to_string(name.size());
+		key += ':';
+		key += name;
+	}
+	key += '\x01';
+	for (const std::string_view word : query.plus_words) {
+		key += word;
+		key += ' ';
+	}
+	key += '\x01';
+	for (const std::string_view word : query.minus_words) {
+		key += word;
+		key += ' ';
+	}
+}
+
+void SearchServer::ResolveQuery(const Query & query_words, QueryTerms & query_terms) const {
+	query_terms.plus_terms.clear();
+	query_terms.minus_terms.clear();
+	for (const auto & plus : query_words.plus_words) {
+		// пропускаем слова без документов, чтобы не делить на 0 при расчете idf
+		const auto term_id = index_.FindTerm(plus);
+		if (!term_id || index_.GetDocumentFrequency(*term_id) == 0) {
+			continue;
+		}
+		// Повторяющиеся в запросах слова берут idf из кэша индекса
+		query_terms.plus_terms.push_back({*term_id, index_.GetIdf(*term_id)});
+	}
+	for (const auto & minus : query_words.minus_words) {
+		const auto term_id = index_.FindTerm(minus);
+		if (term_id) {
+			query_terms.minus_terms.push_back(*term_id);
+		}
+	}
+}
+
+SearchServer::LocalQueryContext::LocalQueryContext() {
+	auto & pool = LocalPool();
+	if (pool.empty()) {
+		context_ = std::make_unique<QueryContext>();
+	} else {
+		context_ = std::move(pool.back());
+		pool.pop_back();
+	}
+}
+
+SearchServer::LocalQueryContext::~LocalQueryContext() {
+	LocalPool().push_back(std::move(context_));
+}
+
+SearchServer::QueryContext & SearchServer::LocalQueryContext::operator*() const {
+	return *context_;
+}
+
+SearchServer::QueryContext * SearchServer::LocalQueryContext::operator->() const {
+	return context_.get();
+}
+
+std::vector<std::unique_ptr<SearchServer::QueryContext>> & SearchServer::LocalQueryContext::LocalPool() {
+	thread_local std::vector<std::unique_ptr<QueryContext>> pool;
+	return pool;
+}
+
+SearchServer::LocalCursors::LocalCursors() {
+	auto & pool = LocalPool();
+	if (pool.empty()) {
+		cursors_ = std::make_unique<std::vector<PostingList::Cursor>>();
+	} else {
+		cursors_ = std::move(pool.back());
+		pool.pop_back();
+	}
+}
+
+SearchServer::LocalCursors::~LocalCursors() {
+	LocalPool().push_back(std::move(cursors_));
+}
+
+std::vector<PostingList::Cursor> & SearchServer::LocalCursors::operator*() const {
+	return *cursors_;
+}
+
+std::vector<PostingList::Cursor> * SearchServer::LocalCursors::operator->() const {
+	return cursors_.get();
+}
+
+std::vector<std::unique_ptr<std::vector<PostingList::Cursor>>> & SearchServer::LocalCursors::LocalPool() {
+	thread_local std::vector<std::unique_ptr<std::vector<PostingList::Cursor>>> pool;
+	return pool;
 }
 
-bool SearchServer::HasWordInDocument(std::string_view word, int document_id) const {
-	return documents_with_tf_.count(word) != 0
-		&& documents_with_tf_.at(word).count(document_id) != 0;
+const DocumentBitmap * SearchServer::GetAllowedDocuments(const SearchOptions & options,
+	const DocumentBitmap * status_documents, std::optional<DocumentBitmap> & storage) const
+{
+	const DocumentBitmap * allowed = status_documents;
+	if (!allowed && options.document_sets.empty() && documents_.GetRemovedCount() > 0) {
+		return &live_documents_;
+	}
+	for (const std::string & name : options.document_sets) {
+		const auto it = document_sets_.find(name);
+		if (it == document_sets_.end()) {
+			throw std::invalid_argument("Unknown document set");
+		}
+		if (!allowed) {
+			allowed = &it->second;
+			continue;
+		}
+		storage = DocumentBitmap::Intersect(*allowed, it->second);
+		allowed = &*storage;
+	}
+	return allowed;
+}
+
+SearchServer::DocumentRange SearchServer::GetFullDocumentRange() const {
+	return {0, static_cast<DocumentOrdinal>(documents_.GetOrdinalCount())};
+}
+
+std::vector<SearchServer::DocumentRange> SearchServer::SplitDocumentRange(size_t part_count) const {
+	const size_t ordinal_count = documents_.GetOrdinalCount();
+	if (part_count == 0) {
+		// Мелкие части не окупают запуск потоков
+		constexpr size_t MIN_DOCUMENTS_PER_PART = 1024;
+		part_count = std::clamp<size_t>(ordinal_count / MIN_DOCUMENTS_PER_PART,
+			1, thread_pool_->GetConcurrency());
+	}
+	std::vector<DocumentRange> ranges;
+	ranges.reserve(part_count);
+	for (size_t i = 0; i < part_count; ++i) {
+		ranges.push_back({static_cast<DocumentOrdinal>(ordinal_count * i / part_count),
+			static_cast<DocumentOrdinal>(ordinal_count * (i + 1) / part_count)});
+	}
+	return ranges;
+}
+
+void SearchServer::ExcludeMinusWords(const QueryTerms & query_terms, DocumentRange range,
+	size_t candidate_count, ScoreAccumulator & accumulator, std::vector<PostingList::Cursor> & minus_cursors) const
+{
+	minus_cursors.clear();
+	for (InvertedIndex::TermId term_id : query_terms.minus_terms) {
+		const PostingList & postings = index_.GetPostings(term_id);
+		if (postings.CountInRange(range.first, range.last) > candidate_count * GALLOPING_RATIO) {
+			minus_cursors.push_back(index_.GetCursor(term_id, range.first, range.last));
+			continue;
+		}
+		postings.ForEach(range.first, range.last, [&accumulator](DocumentOrdinal ordinal, double) {
+			accumulator.Exclude(ordinal);
+		});
+	}
+}
+
+bool SearchServer::HasMinusWord(std::vector<PostingList::Cursor> & minus_cursors, DocumentOrdinal ordinal) {
+	for (PostingList::Cursor & cursor : minus_cursors) {
+		cursor.SkipTo(ordinal);
+		if (cursor.GetOrdinal() == ordinal) {
+			return true;
+		}
+	}
+	return false;
+}
+
+bool SearchServer::HasWordInDocument(std::string_view word, const DocumentTable::Terms & terms) const {
+	const auto term_id = index_.FindTerm(word);
+	return term_id && HasTermInDocument(*term_id, terms);
+}
+
+bool SearchServer::HasTermInDocument(InvertedIndex::TermId term_id, const DocumentTable::Terms & terms) {
+	return std::binary_search(terms.begin(), terms.end(),
+		InvertedIndex::TermFrequency{term_id, 0.0},
+		[](const auto & lhs, const auto & rhs) {
+			return lhs.term_id < rhs.term_id;
+		});
+}
+
+std::vector<InvertedIndex::TermFrequency> SearchServer::MakeDocumentTerms(
+	std::vector<InvertedIndex::TermFrequency> term_frequencies)
+{
+	std::stable_sort(term_frequencies.begin(), term_frequencies.end(),
+		[](const auto & lhs, const auto & rhs) {
+			return lhs.term_id < rhs.term_id;
+		});
+	std::vector<InvertedIndex::TermFrequency> terms;
+	for (const auto & [term_id, tf] : term_frequencies) {
+		if (terms.empty() || terms.back().term_id != term_id) {
+			terms.push_back({term_id, 0.0});
+		}
+		// tf повторяющегося слова накапливается сложением, как раньше в словаре частот
+		terms.back().tf += tf;
+	}
+	// Прямой индекс хранит tf с той же точностью, что и списки вхождений
+	for (auto & term : terms) {
+		term.tf = PostingList::QuantizeTf(term.tf);
+	}
+	return terms;
+}
+
+DocumentOrdinal SearchServer::AcquireOrdinal(int document_id, int rating, DocumentStatus status,
+	uint32_t length, DocumentTable::Terms terms)
+{
+	const DocumentOrdinal ordinal = documents_.Add(document_id, rating, status, length, std::move(terms));
+	status_documents_.at(static_cast<size_t>(status)).Add(ordinal);
+	live_documents_.Add(ordinal);
+	index_.SetDocumentCount(documents_.GetDocumentCount());
+	++generation_;
+	return ordinal;
+}
+
+void SearchServer::ReleaseOrdinal(DocumentOrdinal ordinal) {
+	status_documents_.at(static_cast<size_t>(documents_.GetStatus(ordinal))).Remove(ordinal);
+	live_documents_.Remove(ordinal);
+	for (auto & [name, documents] : document_sets_) {
+		documents.Remove(ordinal);
+	}
+	documents_.Remove(ordinal);
+	index_.SetDocumentCount(documents_.GetDocumentCount());
+	++generation_;
+}
+
+void SearchServer::ReleaseOrdinals(const std::vector<DocumentOrdinal> & ordinals) {
+	for (DocumentBitmap & documents : status_documents_) {
+		documents.RemoveSorted(ordinals);
+	}
+	live_documents_.RemoveSorted(ordinals);
+	for (auto & [name, documents] : document_sets_) {
+		documents.RemoveSorted(ordinals);
+	}
+	for (const DocumentOrdinal ordinal : ordinals) {
+		documents_.Remove(ordinal);
+	}
+	index_.SetDocumentCount(documents_.GetDocumentCount());
+	++generation_;
+}
+
+void SearchServer::CompactOrdinals() {
+	if (documents_.GetRemovedCount() == 0) {
+		return;
+	}
+	const std::vector<DocumentOrdinal> new_ordinals = documents_.Compact();
+	index_.RemapOrdinals(new_ordinals);
+	live_documents_.Remap(new_ordinals);
+	for (DocumentBitmap & documents : status_documents_) {
+		documents.Remap(new_ordinals);
+	}
+	for (auto & [name, documents] : document_sets_) {
+		documents.Remap(new_ordinals);
+	}
+}
+
+void SearchServer::PurgeEmptyTermsIfSparse() {
+	// Словарь перестраивается целиком, поэтому так же выполняется не чаще,
+	// чем пустеет половина слов
+	if (index_.GetEmptyTermCount() * 2 <= index_.GetTermCount()) {
+		return;
+	}
+	const std::vector<InvertedIndex::TermId> new_term_ids = index_.PurgeEmptyTerms();
+	documents_.RemapTerms(new_term_ids);
+	state_id_.Update();
 }
 
 bool SearchServer::IsValidWord(std::string_view word) {
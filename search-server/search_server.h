@@ -1,5 +1,6 @@
 #pragma once
 
+#include <array>
 #include <string>
 #include <vector>
 #include <tuple>
@@ -8,13 +9,52 @@
 #include <algorithm>
 #include <stdexcept>
 #include <execution>
-#include <deque>
+#include <limits>
+#include <numeric>
+#include <optional>
+#include <type_traits>
+#include <memory>
 #include "document.h"
+#include "document_bitmap.h"
+#include "document_table.h"
+#include "result_cache.h"
 #include "string_processing.h"
-#include "concurrent_map.h"
+#include "inverted_index.h"
+#include "score_accumulator.h"
+#include "top_documents.h"
+#include "thread_pool.h"
 
 inline constexpr int MAX_RESULT_DOCUMENT_COUNT = 5;
-inline constexpr double EPSILON = 1e-6;
+
+// Способ вычисления релевантности в FindTopDocuments
+enum class ScoringStrategy {
+	// Считается релевантность всех документов, содержащих плюс-слова
+	EXHAUSTIVE,
+	// Алгоритм MaxScore: документы, которые по верхним границам вкладов слов
+	// не могут попасть в top_k, пропускаются. Результат совпадает с EXHAUSTIVE.
+	// Быстрее, когда частоты слов сильно различаются, как в текстах на естественном языке
+	MAX_SCORE
+};
+
+// Параметры выполнения FindTopDocuments
+struct SearchOptions {
+	// Количество возвращаемых документов
+	size_t top_k = MAX_RESULT_DOCUMENT_COUNT;
+	ScoringStrategy strategy = ScoringStrategy::EXHAUSTIVE;
+	// Число частей, на которые параллельная версия делит документы. 0 - по числу потоков пула
+	size_t partition_count = 0;
+	// Имена множеств документов (SearchServer::SetDocumentSet), которым должен
+	// принадлежать каждый найденный документ
+	std::vector<std::string> document_sets;
+};
+
+// Документ для пакетного добавления
+struct DocumentRecord {
+	int id;
+	std::string_view text;
+	DocumentStatus status;
+	std::vector<int> ratings;
+};
 
 class SearchServer {
 public:
@@ -28,20 +68,47 @@ public:
 
 	void AddDocument(int document_id, std::string_view document,
 		DocumentStatus status, const std::vector<int> & ratings);
+	// Добавляет пакет документов. Тексты разбираются параллельно на пуле потоков,
+	// а списки вхождений дополняются одним проходом, сгруппированным по словам.
+	// Если хотя бы один документ некорректен, сервер не изменяется
+	void AddDocuments(const std::vector<DocumentRecord> & documents);
 
-	// Возвращает топ-5 самых релевантных документов
+	// Возвращает топ-5 самых релевантных документов или top_k из SearchOptions
 	std::vector<Document> FindTopDocuments(std::string_view raw_query,
 		DocumentStatus status = DocumentStatus::ACTUAL) const;
 	template <typename ExecutionPolicy>
 	std::vector<Document> FindTopDocuments(const ExecutionPolicy & policy,
 		std::string_view raw_query, DocumentStatus status = DocumentStatus::ACTUAL) const;
 
+	// Filter вызывается как filter(id, status, rating) для найденных документов. Многопоточная версия вызывает копии одного filter из нескольких потоков
+	// одновременно, поэтому он должен быть потокобезопасным и не зависеть от порядка вызовов
 	template <typename Filter>
 	std::vector<Document> FindTopDocuments(std::string_view raw_query, Filter filter) const;
 	template <typename ExecutionPolicy, typename Filter>
 	std::vector<Document> FindTopDocuments(const ExecutionPolicy & policy,
 		std::string_view raw_query, Filter filter) const;
 
+	// Версии с параметрами поиска, например, с другим количеством документов в выдаче
+	std::vector<Document> FindTopDocuments(std::string_view raw_query,
+		DocumentStatus status, const SearchOptions & options) const;
+	template <typename ExecutionPolicy>
+	std::vector<Document> FindTopDocuments(const ExecutionPolicy & policy,
+		std::string_view raw_query, DocumentStatus status, const SearchOptions & options) const;
+	template <typename Filter>
+	std::vector<Document> FindTopDocuments(std::string_view raw_query, Filter filter,
+		const SearchOptions & options) const;
+	template <typename ExecutionPolicy, typename Filter>
+	std::vector<Document> FindTopDocuments(const ExecutionPolicy & policy,
+		std::string_view raw_query, Filter filter, const SearchOptions & options) const;
+
+	// Буферы запроса для повторного использования, определены после класса
+	class QueryContext;
+	// Последовательная версия, которая в установившемся режиме не выделяет память: слова запроса,
+	// куча лучших документов, буферы MaxScore и результат хранятся в context. Возвращает результат
+	// из context, он действителен до следующего поиска с этим контекстом
+	const std::vector<Document> & FindTopDocuments(QueryContext & context, std::string_view raw_query,
+		DocumentStatus status = DocumentStatus::ACTUAL, const SearchOptions & options = SearchOptions{}) const;
+
 	// Возвращает статус документа и слова запроса, содержащиеся в документе с заданным ID
 	MatchedDocuments MatchDocument(std::string_view raw_query, int document_id) const;
 	MatchedDocuments MatchDocument(const std::execution::sequenced_policy & seq,
@@ -56,25 +123,104 @@ public:
 	std::set<int>::const_iterator begin() const;
 	std::set<int>::const_iterator end() const;
 
+	// Слова документа в виде пар (id слова, tf), упорядоченных по id слова
+	const std::vector<InvertedIndex::TermFrequency> & GetDocumentTerms(int document_id) const;
+	std::string_view GetTerm(InvertedIndex::TermId term_id) const;
+	// Число слов в словаре индекса, включая слова, у которых не осталось документов
+	size_t GetTermCount() const;
+	// Словарь слово - tf документа, построенный по GetDocumentTerms. Словари последних
+	// WORD_FREQUENCY_CACHE_SIZE обращений хранятся в буфере вызывающего потока, поэтому память
+	// под них ограничена, а потоки не ждут друг друга. Ссылка действительна до изменения сервера
+	// и пока тот же поток не запросит словари WORD_FREQUENCY_CACHE_SIZE других документов
+	static constexpr size_t WORD_FREQUENCY_CACHE_SIZE = 16;
 	const std::map<std::string_view, double> & GetWordFrequencies(int document_id) const;
 
+	// Удаление помечает документ удаленным за время, пропорциональное числу его слов.
+	// Вхождения документа остаются в списках до сжатия индекса, поиск их пропускает.
+	// Удаление никогда не сжимает индекс, это делает только Compact
 	void RemoveDocument(int document_id);
 	void RemoveDocument(const std::execution::sequenced_policy & seq, int document_id);
+	// Оставлена для совместимости и выполняется последовательно
 	void RemoveDocument(const std::execution::parallel_policy & par, int document_id);
-
+	// Удаляет пакет документов, неизвестные id пропускаются. Множества документов
+	// обновляются одним проходом, эпоха idf и поколение кэша меняются один раз на пакет
+	void RemoveDocuments(const std::vector<int> & document_ids);
+	// Удаленных документов больше, чем живых, и сжатие индекса окупится
+	bool NeedsCompaction() const;
+	// Сжимает индекс: перенумеровывает документы подряд и выбрасывает из списков вхождений
+	// удаленные документы. Без удаленных документов ничего не делает, списки с номерами
+	// только до первого удаленного документа не перестраиваются. Сам не вызывается, время
+	// сжатия выбирает владелец сервера, например по NeedsCompaction. Отдельный список вхождений
+	// очищается раньше, при удалении документов, как только удаленных вхождений в нем
+	// становится больше, чем живых. Если слов без документов в словаре больше, чем остальных,
+	// они выбрасываются, а хранилище строк словаря перестраивается: id слов и строки,
+	// полученные из GetTerm и MatchDocument, становятся недействительными, как и ссылки
+	// на словари GetWordFrequencies. ConcurrentSearchServer::Compact сжимает копию сервера
+	// в фоне, не останавливая ни поиск, ни писателя
+	void Compact();
+
+	// Сохраняет стоп-слова, данные документов, словарь и списки вхождений в бинарный снимок.
+	// Тексты документов в снимок не попадают
+	void SaveSnapshot(const std::string & path) const;
+	// Создает сервер из снимка без повторного разбора текстов. Файл отображается в память,
+	// списки вхождений копируются из него целыми массивами
+	static SearchServer LoadSnapshot(const std::string & path);
+
+	// Регистрирует именованное множество документов, например, документы одного арендатора
+	// или языка. Повторная регистрация заменяет множество, удаленные документы из него выбывают.
+	// Множества не сохраняются в снимок
+	void SetDocumentSet(const std::string & name, const std::vector<int> & document_ids);
+	void RemoveDocumentSet(std::string_view name);
+
+	// Включает кэш результатов FindTopDocuments с фильтром по статусу на capacity запросов.
+	// Ключ кэша - упорядоченные плюс- и минус-слова запроса без повторов и стоп-слов, статус,
+	// top_k и множества документов. Добавление и удаление документов и изменение множеств
+	// меняют поколение индекса, и посчитанные ранее результаты перестают использоваться
+	void EnableResultCache(size_t capacity, size_t shard_count = ResultCache::DEFAULT_SHARD_COUNT);
+	void DisableResultCache();
+	// Попадания и промахи кэша результатов. Без кэша возвращает нули
+	ResultCache::Stats GetResultCacheStats() const;
+
+	// Пул потоков для параллельных версий методов и ProcessQueries.
+	// По умолчанию используется общий пул процесса. Пул должен пережить сервер
+	void SetThreadPool(ThreadPool & thread_pool);
+	ThreadPool & GetThreadPool() const;
 
 private:
-	std::deque<std::string> storage_;
 	std::set<std::string, std::less<>> stop_words_;
 
-	struct DocumentInfo {
-		int rating;
-		DocumentStatus status;
-		std::map<std::string_view, double> words;
-	};
-	std::map<int, DocumentInfo> documents_info_;
+	DocumentTable documents_; // данные документов по номеру документа
+	// Номера документов с каждым статусом, индекс - значение DocumentStatus
+	static constexpr size_t STATUS_COUNT = 4;
+	std::array<DocumentBitmap, STATUS_COUNT> status_documents_;
+	std::map<std::string, DocumentBitmap, std::less<>> document_sets_;
+	// Номера живых документов. Удаленные документы отсутствуют в нем до сжатия индекса
+	DocumentBitmap live_documents_;
 	std::set<int> documents_id_;
-	std::map<std::string_view, std::map<int, double>> documents_with_tf_; // слово - id док-та, tf
+	InvertedIndex index_; // слово - номер док-та, tf
+	ThreadPool * thread_pool_ = &ThreadPool::GetDefault();
+	// Поколение индекса, меняется при каждом изменении выдачи
+	uint64_t generation_ = 0;
+	mutable std::optional<ResultCache> result_cache_; // заполняется из константных запросов
+
+	// Номер состояния документов и словаря, уникальный в процессе: по нему поток узнает
+	// свои словари GetWordFrequencies. Меняется при удалении документов и перестройке словаря,
+	// копия сервера получает новый номер
+	class StateId {
+	public:
+		StateId();
+		StateId(const StateId &);
+		StateId & operator=(const StateId &);
+
+		uint64_t Get() const {
+			return value_;
+		}
+		void Update();
+
+	private:
+		uint64_t value_;
+	};
+	StateId state_id_;
 
 	struct Query {
 		std::vector<std::string_view> plus_words;
@@ -89,30 +235,157 @@ private:
 
 	bool IsStopWord(std::string_view word) const;
 
-	std::vector<std::string_view> SplitIntoWordsNoStop(std::string_view text) const;
+	// Разбивает текст на слова без стоп-слов, проверяя его тем же проходом.
+	// Возвращает false, если в тексте есть управляющие символы
+	bool SplitIntoWordsNoStop(std::string_view text, std::vector<std::string_view> & words) const;
 
 	// Проверяет, является ли слово стоп-словом и минус-словом
 	QueryWord CheckWord(std::string_view word) const;
 
 	// Разбивает строку на упорядоченный массив строк без повторений без стоп-слов
 	Query ParseQuery(std::string_view text, bool needSortAndUnique = true) const;
+	// То же в переиспользуемые буферы: tokens - слова строки, query - результат
+	void ParseQuery(std::string_view text, std::vector<std::string_view> & tokens, Query & query,
+		bool needSortAndUnique = true) const;
 
 	template <typename Container>
 	std::set<std::string, std::less<>> MakeStopWords(const Container & container);
 
+	// Отрезок номеров документов [first, last)
+	struct DocumentRange {
+		DocumentOrdinal first;
+		DocumentOrdinal last;
+	};
+
+	// Слово запроса, найденное в индексе
+	struct QueryTerm {
+		InvertedIndex::TermId term_id;
+		double idf;
+	};
+	struct QueryTerms {
+		std::vector<QueryTerm> plus_terms;
+		std::vector<InvertedIndex::TermId> minus_terms;
+	};
+
+	// Находит слова запроса в индексе и берет idf плюс-слов из кэша индекса
+	void ResolveQuery(const Query & query_words, QueryTerms & query_terms) const;
+
+	DocumentRange GetFullDocumentRange() const;
+	// Делит номера документов на part_count отрезков, при 0 - по числу потоков пула
+	std::vector<DocumentRange> SplitDocumentRange(size_t part_count) const;
+
+	// Контекст запроса из пула потока для версий FindTopDocuments без явного контекста.
+	// В пуле может быть несколько контекстов, чтобы вложенный запрос (например, из задачи пула,
+	// выполняемой во время ожидания) не делил буферы с внешним
+	class LocalQueryContext {
+	public:
+		LocalQueryContext();
+		LocalQueryContext(const LocalQueryContext &) = delete;
+		LocalQueryContext & operator=(const LocalQueryContext &) = delete;
+		~LocalQueryContext();
+
+		QueryContext & operator*() const;
+		QueryContext * operator->() const;
+
+	private:
+		std::unique_ptr<QueryContext> context_;
+
+		static std::vector<std::unique_ptr<QueryContext>> & LocalPool();
+	};
+
+	// Поиск с фильтром по статусу с учетом кэша результатов. Результат остается в context
+	template <typename ExecutionPolicy>
+	void FindTopDocumentsByStatus(const ExecutionPolicy & policy, QueryContext & context,
+		std::string_view raw_query, DocumentStatus status, const SearchOptions & options) const;
+	// Поиск по разобранному в context запросу с фильтром по статусу в виде множества
+	// status_documents (nullptr - без него). Результат остается в context
+	template <typename ExecutionPolicy, typename Filter>
+	void FindTopDocumentsInContext(const ExecutionPolicy & policy, QueryContext & context,
+		Filter filter, const SearchOptions & options, const DocumentBitmap * status_documents) const;
+
+	// Записывает в key ключ кэша результатов. Слова запроса уже упорядочены и не повторяются
+	static void MakeResultCacheKey(const Query & query, DocumentStatus status,
+		const SearchOptions & options, std::string & key);
+
+	// Сводит множество документов со статусом и именованные множества из options в одно.
+	// Без них ограничивает поиск живыми документами, если в индексе есть удаленные.
+	// Возвращает nullptr, если ограничений нет. Пересечение при необходимости строится в storage
+	const DocumentBitmap * GetAllowedDocuments(const SearchOptions & options,
+		const DocumentBitmap * status_documents, std::optional<DocumentBitmap> & storage) const;
+
+	// Буферы отбора MaxScore: курсоры слов запроса, границы их вкладов в окне и порядок слов
+	struct MaxScoreBuffers {
+		std::vector<PostingList::Cursor> cursors;
+		std::vector<PostingList::Cursor> probe_cursors;
+		std::vector<double> bounds;
+		std::vector<size_t> order;
+		std::vector<double> bound_prefix;
+		std::vector<char> is_essential;
+	};
+
+	// Добавляет в top лучшие документы из отрезка range, отобранные выбранным в options способом.
+	// Документы вне allowed (если оно задано) не получают счет и не проверяются фильтром
 	template <typename Filter>
-	std::vector<Document> FindAllDocuments(const std::execution::sequenced_policy & seq,
-		const Query& query_words, Filter filter) const;
+	void FindTopDocumentsInRange(const QueryTerms & query_terms, DocumentRange range,
+		const DocumentBitmap * allowed, Filter filter, const SearchOptions & options,
+		MaxScoreBuffers & buffers, TopDocuments & top) const;
+
+	// Считает релевантность документов из отрезка range и передает
+	// прошедшие фильтр документы в consume
+	template <typename Filter, typename Consumer>
+	void ScoreDocumentRange(const QueryTerms & query_terms, DocumentRange range,
+		const DocumentBitmap * allowed, Filter filter, Consumer consume) const;
+
 	template <typename Filter>
-	std::vector<Document> FindAllDocuments(const std::execution::parallel_policy & par,
-		const Query& query_words, Filter filter) const;
+	void FindTopDocumentsMaxScore(const QueryTerms & query_terms, DocumentRange range,
+		const DocumentBitmap * allowed, Filter filter, MaxScoreBuffers & buffers, TopDocuments & top) const;
 
-	double CalcIdf(std::string_view word) const;
+	// Список минус-слова, длиннее числа кандидатов в GALLOPING_RATIO раз, выгоднее проверять
+	// пропусками блоков только для кандидатов, чем обходить целиком
+	static constexpr size_t GALLOPING_RATIO = 8;
 
-	bool HasWordInDocument(std::string_view word, int document_id) const;
+	// Буфер курсоров минус-слов из пула потока. Как и контекстов, буферов в пуле может быть
+	// несколько, чтобы вложенный запрос из фильтра не делил буфер с внешним
+	class LocalCursors {
+	public:
+		LocalCursors();
+		LocalCursors(const LocalCursors &) = delete;
+		LocalCursors & operator=(const LocalCursors &) = delete;
+		~LocalCursors();
 
-	template <typename WordsContainer>
-	static bool IsValidAllWords(WordsContainer & words);
+		std::vector<PostingList::Cursor> & operator*() const;
+		std::vector<PostingList::Cursor> * operator->() const;
+
+	private:
+		std::unique_ptr<std::vector<PostingList::Cursor>> cursors_;
+
+		static std::vector<std::unique_ptr<std::vector<PostingList::Cursor>>> & LocalPool();
+	};
+
+	// Помечает в аккумуляторе документы из отрезка range, содержащие минус-слова с короткими
+	// списками. Для длинных списков записывает в minus_cursors курсоры, по которым проверяются кандидаты
+	void ExcludeMinusWords(const QueryTerms & query_terms, DocumentRange range, size_t candidate_count,
+		ScoreAccumulator & accumulator, std::vector<PostingList::Cursor> & minus_cursors) const;
+	// Проверяет документ по курсорам минус-слов. Номера проверяемых документов должны возрастать
+	static bool HasMinusWord(std::vector<PostingList::Cursor> & minus_cursors, DocumentOrdinal ordinal);
+
+	bool HasWordInDocument(std::string_view word, const DocumentTable::Terms & terms) const;
+	static bool HasTermInDocument(InvertedIndex::TermId term_id, const DocumentTable::Terms & terms);
+	// Упорядочивает пары (id слова, tf) по id слова, складывая tf повторяющихся слов
+	static std::vector<InvertedIndex::TermFrequency> MakeDocumentTerms(
+		std::vector<InvertedIndex::TermFrequency> term_frequencies);
+
+	// Заносит документ в таблицу, множество живых документов и множество документов его статуса
+	DocumentOrdinal AcquireOrdinal(int document_id, int rating, DocumentStatus status,
+		uint32_t length, DocumentTable::Terms terms);
+	void ReleaseOrdinal(DocumentOrdinal ordinal);
+	// То же для упорядоченных по возрастанию номеров пакета: множества документов
+	// обновляются одним проходом, эпоха idf и поколение кэша меняются один раз
+	void ReleaseOrdinals(const std::vector<DocumentOrdinal> & ordinals);
+	// Перенумеровывает документы подряд и выбрасывает из списков вхождений удаленные документы
+	void CompactOrdinals();
+	// Выбрасывает из словаря слова без документов, если их больше, чем остальных
+	void PurgeEmptyTermsIfSparse();
 
 	static bool IsValidWord(std::string_view word);
 
@@ -120,6 +393,30 @@ private:
 	static int ComputeAverageRating(const std::vector<int> & ratings);
 };
 
+// Буферы одного запроса: слова строки запроса, разобранный запрос, найденные в индексе слова,
+// куча лучших документов, курсоры и границы слов MaxScore, ключ кэша и результат. Буферы сохраняют
+// емкость между запросами, поэтому последовательный поиск с переиспользуемым контекстом не выделяет память.
+// Контекст нельзя одновременно использовать из нескольких потоков
+class SearchServer::QueryContext {
+public:
+	// Результат последнего поиска с этим контекстом
+	const std::vector<Document> & GetResults() const {
+		return results_;
+	}
+
+private:
+	friend class SearchServer;
+
+	// Слова запроса ссылаются на строку последнего запроса
+	std::vector<std::string_view> tokens_;
+	Query query_;
+	QueryTerms query_terms_;
+	TopDocuments top_{0};
+	MaxScoreBuffers max_score_;
+	std::string cache_key_;
+	std::vector<Document> results_;
+};
+
 
 template <typename Container>
 SearchServer::SearchServer(const Container & container)
@@ -130,10 +427,7 @@ template <typename ExecutionPolicy>
 std::vector<Document> SearchServer::FindTopDocuments(const ExecutionPolicy & policy,
 	std::string_view raw_query, DocumentStatus status) const
 {
-	return FindTopDocuments(policy, raw_query,
-		[status](int, DocumentStatus document_status, int) {
-			return document_status == status;
-		});
+	return FindTopDocuments(policy, raw_query, status, SearchOptions{});
 }
 
 template <typename Filter>
@@ -145,24 +439,89 @@ template <typename ExecutionPolicy, typename Filter>
 std::vector<Document> SearchServer::FindTopDocuments(const ExecutionPolicy & policy,
 	std::string_view raw_query, Filter filter) const
 {
-	Query query_words = ParseQuery(raw_query, false);
-	SortAndRemoveDuplicates(policy, query_words.plus_words);
-	SortAndRemoveDuplicates(policy, query_words.minus_words);
+	return FindTopDocuments(policy, raw_query, filter, SearchOptions{});
+}
 
-	std::vector<Document> result = FindAllDocuments(policy, query_words, filter);
+template <typename ExecutionPolicy>
+std::vector<Document> SearchServer::FindTopDocuments(const ExecutionPolicy & policy,
+	std::string_view raw_query, DocumentStatus status, const SearchOptions & options) const
+{
+	LocalQueryContext context;
+	FindTopDocumentsByStatus(policy, *context, raw_query, status, options);
+	return context->results_;
+}
 
-	std::sort(policy, result.begin(), result.end(),
-		[](const Document & lhs, const Document & rhs) {
-			if (std::abs(lhs.relevance - rhs.relevance) < EPSILON) {
-				return lhs.rating > rhs.rating;
-			}
-			return lhs.relevance > rhs.relevance;
-		});
+template <typename Filter>
+std::vector<Document> SearchServer::FindTopDocuments(std::string_view raw_query, Filter filter,
+	const SearchOptions & options) const
+{
+	return FindTopDocuments(std::execution::seq, raw_query, filter, options);
+}
 
-	if (result.size() > MAX_RESULT_DOCUMENT_COUNT) {
-		result.resize(MAX_RESULT_DOCUMENT_COUNT);
+template <typename ExecutionPolicy, typename Filter>
+std::vector<Document> SearchServer::FindTopDocuments(const ExecutionPolicy & policy,
+	std::string_view raw_query, Filter filter, const SearchOptions & options) const
+{
+	LocalQueryContext context;
+	ParseQuery(raw_query, context->tokens_, context->query_);
+	FindTopDocumentsInContext(policy, *context, filter, options, nullptr);
+	return context->results_;
+}
+
+template <typename ExecutionPolicy>
+void SearchServer::FindTopDocumentsByStatus(const ExecutionPolicy & policy, QueryContext & context,
+	std::string_view raw_query, DocumentStatus status, const SearchOptions & options) const
+{
+	ParseQuery(raw_query, context.tokens_, context.query_);
+	if (result_cache_) {
+		MakeResultCacheKey(context.query_, status, options, context.cache_key_);
+		if (result_cache_->Find(context.cache_key_, generation_, context.results_)) {
+			return;
+		}
+	}
+	// Статус проверяется по множеству документов до подсчета релевантности
+	FindTopDocumentsInContext(policy, context,
+		[](int, DocumentStatus, int) {
+			return true;
+		}, options, &status_documents_.at(static_cast<size_t>(status)));
+	if (result_cache_) {
+		result_cache_->Insert(context.cache_key_, generation_, context.results_);
+	}
+}
+
+template <typename ExecutionPolicy, typename Filter>
+void SearchServer::FindTopDocumentsInContext([[maybe_unused]] const ExecutionPolicy & policy,
+	QueryContext & context, Filter filter, const SearchOptions & options,
+	const DocumentBitmap * status_documents) const
+{
+	ResolveQuery(context.query_, context.query_terms_);
+	const QueryTerms & query_terms = context.query_terms_;
+	std::optional<DocumentBitmap> intersection;
+	const DocumentBitmap * allowed = GetAllowedDocuments(options, status_documents, intersection);
+
+	if constexpr (std::is_same_v<std::decay_t<ExecutionPolicy>, std::execution::parallel_policy>) {
+		// Каждая часть номеров документов считается по всем словам запроса независимо
+		// и отбирает свои top_k документов, затем кучи частей объединяются
+		const std::vector<DocumentRange> ranges = SplitDocumentRange(options.partition_count);
+		// Куча части создается в ее задаче, поэтому память выделяет поток, который ее заполняет
+		std::vector<std::optional<TopDocuments>> parts(ranges.size());
+		thread_pool_->ParallelFor(ranges.size(), [&](size_t i) {
+			parts[i].emplace(options.top_k);
+			// Буферы MaxScore части берутся из пула потока, который ее считает
+			LocalQueryContext part_context;
+			FindTopDocumentsInRange(query_terms, ranges[i], allowed, filter, options,
+				part_context->max_score_, *parts[i]);
+		});
+		for (size_t i = 1; i < parts.size(); ++i) {
+			parts[0]->Merge(*parts[i]);
+		}
+		parts[0]->ExtractTo(context.results_);
+	} else {
+		context.top_.Reset(options.top_k);
+		FindTopDocumentsInRange(query_terms, GetFullDocumentRange(), allowed, filter, options,
+			context.max_score_, context.top_);
+		context.top_.ExtractTo(context.results_);
 	}
-	return result;
 }
 
 template <typename Container>
@@ -182,93 +541,210 @@ std::set<std::string, std::less<>> SearchServer::MakeStopWords(const Container &
 }
 
 template <typename Filter>
-std::vector<Document> SearchServer::FindAllDocuments(
-	[[maybe_unused]] const std::execution::sequenced_policy & seq,
-	const Query & query_words, Filter filter) const
+void SearchServer::FindTopDocumentsInRange(const QueryTerms & query_terms, DocumentRange range,
+	const DocumentBitmap * allowed, Filter filter, const SearchOptions & options,
+	MaxScoreBuffers & buffers, TopDocuments & top) const
 {
-	std::map<int, double> matched_documents;
-	for(const auto & plus : query_words.plus_words) {
-		// нужно, т.к. дальше вызываем documents_with_tf_.at()
-		// также предупреждаем деление на 0
-		if (documents_with_tf_.count(plus) == 0) {
-			continue;
-		}
-		double idf = CalcIdf(plus);
-		for (const auto & [doc_id, tf] : documents_with_tf_.at(plus)) {
-			matched_documents[doc_id] += idf * tf;
-		}
+	if (options.strategy == ScoringStrategy::MAX_SCORE) {
+		FindTopDocumentsMaxScore(query_terms, range, allowed, filter, buffers, top);
+		return;
 	}
-	for(const auto & minus : query_words.minus_words) {
-		// нужно, т.к. дальше вызываем documents_with_tf_.at()
-		// также предупреждаем деление на 0
-		if (documents_with_tf_.count(minus) == 0) {
-			continue;
-		}
-		for (const auto & [doc_id, tf] : documents_with_tf_.at(minus)) {
-			matched_documents.erase(doc_id);
-		}
+	// Вместо полной сортировки держим кучу из top_k лучших документов
+	ScoreDocumentRange(query_terms, range, allowed, filter,
+		[&top](const Document & document) {
+			top.Push(document);
+		});
+}
+
+template <typename Filter, typename Consumer>
+void SearchServer::ScoreDocumentRange(const QueryTerms & query_terms, DocumentRange range,
+	const DocumentBitmap * allowed, Filter filter, Consumer consume) const
+{
+	auto accumulator = ScoreAccumulatorPool::Acquire(range.first, range.last);
+	for (const QueryTerm & term : query_terms.plus_terms) {
+		index_.GetPostings(term.term_id).ForEach(range.first, range.last,
+			[&accumulator, &term, allowed](DocumentOrdinal ordinal, double tf) {
+				if (!allowed || allowed->Contains(ordinal)) {
+					accumulator->Add(ordinal, term.idf * tf);
+				}
+			});
 	}
-	std::vector<Document> result;
-	for (const auto & [id, rel] : matched_documents) {
-		if (filter(id,
-			documents_info_.at(id).status,
-			documents_info_.at(id).rating))
-		{
-			int rating = documents_info_.at(id).rating;
-			result.push_back({id, rel, rating});
-		}
+	// Минус-слова вычитаются из уже известного множества кандидатов
+	LocalCursors minus_cursors;
+	ExcludeMinusWords(query_terms, range, accumulator->GetTouchedCount(), *accumulator, *minus_cursors);
+	if (!minus_cursors->empty()) {
+		accumulator->SortTouched();
 	}
-	return result;
+	accumulator->ForEach([&](DocumentOrdinal ordinal, double relevance) {
+		if (!minus_cursors->empty() && HasMinusWord(*minus_cursors, ordinal)) {
+			return;
+		}
+		const int id = documents_.GetId(ordinal);
+		const int rating = documents_.GetRating(ordinal);
+		if (filter(id, documents_.GetStatus(ordinal), rating)) {
+			consume(Document(id, relevance, rating));
+		}
+	});
 }
 
 template <typename Filter>
-std::vector<Document> SearchServer::FindAllDocuments(const std::execution::parallel_policy & par,
-	const Query& query_words, Filter filter) const
+void SearchServer::FindTopDocumentsMaxScore(const QueryTerms & query_terms,
+	DocumentRange range, const DocumentBitmap * allowed, Filter filter, MaxScoreBuffers & buffers,
+	TopDocuments & top) const
 {
-	ConcurrentMap<int, double> concurrent_matched_documents(100);
-	std::for_each(par, query_words.plus_words.begin(), query_words.plus_words.end(),
-		[&](auto plus) {
-			// нужно, т.к. дальше вызываем documents_with_tf_.at()
-			// также предупреждаем деление на 0
-			if (documents_with_tf_.count(plus) == 0) {
+	if (top.GetCapacity() == 0) {
+		return;
+	}
+	// Кандидатов не больше, чем вхождений плюс-слов
+	size_t candidate_count = 0;
+	size_t max_posting_count = 0;
+	for (const QueryTerm & term : query_terms.plus_terms) {
+		const size_t posting_count = index_.GetPostings(term.term_id).CountInRange(range.first, range.last);
+		candidate_count += posting_count;
+		max_posting_count = std::max(max_posting_count, posting_count);
+	}
+	if (candidate_count == 0) {
+		return;
+	}
+	auto excluded = ScoreAccumulatorPool::Acquire(range.first, range.last);
+	LocalCursors minus_cursors;
+	ExcludeMinusWords(query_terms, range, candidate_count, *excluded, *minus_cursors);
+
+	// Курсоры идут в порядке слов запроса. По первым обходятся существенные слова окна,
+	// по вторым проверяются несущественные слова кандидатов и пересчитывается релевантность
+	// в том же порядке сложения, что при полном переборе
+	const size_t term_count = query_terms.plus_terms.size();
+	std::vector<PostingList::Cursor> & cursors = buffers.cursors;
+	std::vector<PostingList::Cursor> & probe_cursors = buffers.probe_cursors;
+	cursors.clear();
+	probe_cursors.clear();
+	for (const QueryTerm & term : query_terms.plus_terms) {
+		cursors.push_back(index_.GetCursor(term.term_id, range.first, range.last));
+		probe_cursors.push_back(cursors.back());
+	}
+	std::vector<double> & bounds = buffers.bounds;
+	std::vector<size_t> & order = buffers.order;
+	std::vector<double> & bound_prefix = buffers.bound_prefix;
+	std::vector<char> & is_essential = buffers.is_essential;
+	bounds.resize(term_count);
+	order.resize(term_count);
+	bound_prefix.resize(term_count);
+	is_essential.resize(term_count);
+	auto scores = ScoreAccumulatorPool::Acquire(range.first, range.last);
+
+	// Номера документов обходятся окнами примерно в блок самого частого слова. В окне границы
+	// вкладов слов берутся по блокам, пересекающим окно, и слова упорядочиваются по ним один раз.
+	// Слова с наименьшими границами, которые вместе не дотягивают до порога выдачи, несущественны:
+	// документ, содержащий только их, в выдачу не попадет. Существенные слова считаются по окну
+	// плотным аккумулятором, как при полном переборе, а несущественные проверяются пропусками
+	// только для кандидатов и только пока кандидат еще может дотянуть до порога
+	const uint64_t range_size = range.last - range.first;
+	const uint64_t window_size = std::max<uint64_t>(PostingList::BLOCK_SIZE,
+		range_size * PostingList::BLOCK_SIZE / max_posting_count);
+	// Документ с релевантностью в пределах EPSILON от худшего в куче может его вытеснить
+	// по рейтингу, поэтому отсекаем с запасом
+	constexpr double PRUNING_MARGIN = 2 * EPSILON;
+	const auto get_threshold = [&top]() {
+		return top.IsFull()
+			? top.GetWorst().relevance - PRUNING_MARGIN
+			: -std::numeric_limits<double>::infinity();
+	};
+	for (uint64_t window_first = range.first; window_first < range.last; window_first += window_size) {
+		const DocumentOrdinal first = static_cast<DocumentOrdinal>(window_first);
+		const DocumentOrdinal last = static_cast<DocumentOrdinal>(std::min<uint64_t>(range.last, window_first + window_size));
+		for (size_t i = 0; i < term_count; ++i) {
+			bounds[i] = query_terms.plus_terms[i].idf
+				* index_.GetPostings(query_terms.plus_terms[i].term_id).GetMaxTf(first, last);
+		}
+		std::iota(order.begin(), order.end(), 0);
+		std::sort(order.begin(), order.end(), [&bounds](size_t lhs, size_t rhs) {
+			return bounds[lhs] < bounds[rhs];
+		});
+		double bound_sum = 0.0;
+		for (size_t i = 0; i < term_count; ++i) {
+			bound_sum += bounds[order[i]];
+			bound_prefix[i] = bound_sum;
+		}
+		const double window_threshold = get_threshold();
+		size_t first_essential = 0;
+		while (first_essential < term_count && bound_prefix[first_essential] < window_threshold) {
+			++first_essential;
+		}
+		if (first_essential == term_count) {
+			// Ни один документ окна не наберет порога
+			continue;
+		}
+		for (size_t i = 0; i < term_count; ++i) {
+			is_essential[order[i]] = i >= first_essential;
+		}
+
+		for (size_t i = 0; i < term_count; ++i) {
+			if (!is_essential[i]) {
+				continue;
+			}
+			// Курсор хранит распакованный блок, поэтому блок, пересекающий несколько окон,
+			// распаковывается один раз
+			const double idf = query_terms.plus_terms[i].idf;
+			PostingList::Cursor & cursor = cursors[i];
+			for (cursor.SkipTo(first); cursor.GetOrdinal() < last; cursor.Next()) {
+				scores->Add(cursor.GetOrdinal(), idf * cursor.GetTf());
+			}
+		}
+		// Кандидаты проверяются по возрастанию номеров, поэтому курсоры несущественных слов
+		// идут только вперед. Порог растет по мере заполнения кучи. Принадлежность allowed
+		// проверяется для кандидата, а не для каждого вхождения: большинство кандидатов
+		// отсекается порогом раньше
+		const auto check_candidate = [&](DocumentOrdinal ordinal, double essential_score) {
+			const double threshold = get_threshold();
+			if (essential_score + (first_essential > 0 ? bound_prefix[first_essential - 1] : 0.0) < threshold) {
+				return;
+			}
+			if (excluded->IsExcluded(ordinal) || (allowed && !allowed->Contains(ordinal))) {
 				return;
 			}
-			double idf = CalcIdf(plus);
-			for (const auto & [doc_id, tf] : documents_with_tf_.at(plus)) {
-				concurrent_matched_documents[doc_id].ref_to_value += idf * tf;
+			double score = essential_score;
+			bool has_nonessential = false;
+			for (size_t i = first_essential; i-- > 0;) {
+				if (score + bound_prefix[i] < threshold) {
+					return;
+				}
+				PostingList::Cursor & cursor = probe_cursors[order[i]];
+				cursor.SkipTo(ordinal);
+				if (cursor.GetOrdinal() == ordinal) {
+					score += query_terms.plus_terms[order[i]].idf * cursor.GetTf();
+					has_nonessential = true;
+				}
 			}
-		});
-	std::for_each(par, query_words.minus_words.begin(), query_words.minus_words.end(),
-		[&](auto minus) {
-			// нужно, т.к. дальше вызываем documents_with_tf_.at()
-			// также предупреждаем деление на 0
-			if (documents_with_tf_.count(minus) == 0) {
+			if (score < threshold) {
 				return;
 			}
-			for (const auto & [doc_id, tf] : documents_with_tf_.at(minus)) {
-				concurrent_matched_documents.Erase(doc_id);
+			if (!minus_cursors->empty() && HasMinusWord(*minus_cursors, ordinal)) {
+				return;
 			}
-		});
-	std::map<int, double> matched_documents = concurrent_matched_documents.BuildOrdinaryMap();
-	std::vector<Document> result;
-	for (const auto & [id, rel] : matched_documents) {
-		if (filter(id,
-			documents_info_.at(id).status,
-			documents_info_.at(id).rating))
-		{
-			int rating = documents_info_.at(id).rating;
-			result.push_back({id, rel, rating});
-		}
-	}
-	return result;
-}
-
-template <typename WordsContainer>
-bool SearchServer::IsValidAllWords(WordsContainer & words) {
-	for (const auto & word : words) {
-		if (!IsValidWord(word)) {
-			return false;
+			const int document_id = documents_.GetId(ordinal);
+			const int rating = documents_.GetRating(ordinal);
+			if (!filter(document_id, documents_.GetStatus(ordinal), rating)) {
+				return;
+			}
+			if (has_nonessential) {
+				score = 0.0;
+				for (size_t i = 0; i < term_count; ++i) {
+					probe_cursors[i].SkipTo(ordinal);
+					if (probe_cursors[i].GetOrdinal() == ordinal) {
+						score += query_terms.plus_terms[i].idf * probe_cursors[i].GetTf();
+					}
+				}
+			}
+			top.Push({document_id, score, rating});
+		};
+		// Редкие кандидаты выгоднее упорядочить, чем просматривать все окно
+		constexpr size_t SPARSE_WINDOW_RATIO = 16;
+		if (scores->GetTouchedCount() * SPARSE_WINDOW_RATIO < last - first) {
+			scores->SortTouched();
+			scores->ForEach(check_candidate);
+		} else {
+			scores->ForEachInRange(first, last, check_candidate);
 		}
+		scores->Clear();
 	}
-	return true;
 }
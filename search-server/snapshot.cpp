@@ -0,0 +1,109 @@
+#include "snapshot.h"
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#define SNAPSHOT_HAS_MMAP 1
+#endif
+
+using std::literals::string_literals::operator""s;
+
+SnapshotWriter::SnapshotWriter(const std::string & path)
+	: out_(path, std::ios::binary | std::ios::trunc)
+{
+	if (!out_) {
+		throw std::runtime_error("Can't open snapshot file "s + path);
+	}
+}
+
+void SnapshotWriter::WriteString(std::string_view text) {
+	Write(static_cast<uint32_t>(text.size()));
+	WriteBytes(text.data(), text.size());
+}
+
+void SnapshotWriter::WriteBytes(const void * data, size_t size) {
+	out_.write(static_cast<const char *>(data), static_cast<std::streamsize>(size));
+	offset_ += size;
+}
+
+void SnapshotWriter::Align(size_t alignment) {
+	static const char zeros[alignof(std::max_align_t)] = {};
+	WriteBytes(zeros, (alignment - offset_ % alignment) % alignment);
+}
+
+void SnapshotWriter::Finish() {
+	out_.flush();
+	if (!out_) {
+		throw std::runtime_error("Can't write snapshot file");
+	}
+}
+
+SnapshotReader::SnapshotReader(const std::string & path) {
+#ifdef SNAPSHOT_HAS_MMAP
+	const int fd = open(path.c_str(), O_RDONLY);
+	if (fd < 0) {
+		throw std::runtime_error("Can't open snapshot file "s + path);
+	}
+	struct stat file_stat;
+	if (fstat(fd, &file_stat) != 0) {
+		close(fd);
+		throw std::runtime_error("Can't read snapshot file "s + path);
+	}
+	size_ = static_cast<size_t>(file_stat.st_size);
+	if (size_ > 0) {
+		void * mapping = mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+		if (mapping == MAP_FAILED) {
+			close(fd);
+			throw std::runtime_error("Can't map snapshot file "s + path);
+		}
+		mapping_ = mapping;
+		data_ = static_cast<const char *>(mapping_);
+	}
+	// Отображение остается действительным после закрытия файла
+	close(fd);
+#else
+	std::ifstream in(path, std::ios::binary | std::ios::ate);
+	if (!in) {
+		throw std::runtime_error("Can't open snapshot file "s + path);
+	}
+	size_ = static_cast<size_t>(in.tellg());
+	buffer_ = std::make_unique<char[]>(size_);
+	in.seekg(0);
+	if (!in.read(buffer_.get(), static_cast<std::streamsize>(size_))) {
+		throw std::runtime_error("Can't read snapshot file "s + path);
+	}
+	data_ = buffer_.get();
+#endif
+}
+
+SnapshotReader::~SnapshotReader() {
+#ifdef SNAPSHOT_HAS_MMAP
+	if (mapping_) {
+		munmap(mapping_, size_);
+	}
+#endif
+}
+
+std::string_view SnapshotReader::ReadString() {
+	const uint32_t length = Read<uint32_t>();
+	return std::string_view(Take(length), length);
+}
+
+void SnapshotReader::Align(size_t alignment) {
+	Take((alignment - offset_ % alignment) % alignment);
+}
+
+bool SnapshotReader::IsAtEnd() const {
+	return offset_ == size_;
+}
+
+const char * SnapshotReader::Take(size_t size) {
+	if (size > size_ - offset_) {
+		throw std::runtime_error("Snapshot is corrupted");
+	}
+	const char * result = data_ + offset_;
+	offset_ += size;
+	return result;
+}
@@ -0,0 +1,87 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <type_traits>
+
+// Бинарный снимок поискового сервера.
+// Файл начинается с сигнатуры, версии формата и метки порядка байтов,
+// затем идут секции стоп-слов, документов и слов со сжатыми списками вхождений
+// в том виде, в каком они лежат в памяти (PostingList::Save). Массивы выровнены
+// в файле, поэтому при загрузке они копируются из отображенного в память файла
+// целиком, без разбора по элементам и перепаковки. Прямой индекс не хранится
+// и восстанавливается по спискам вхождений
+inline constexpr char SNAPSHOT_SIGNATURE[8] = {'S', 'R', 'C', 'H', 'S', 'N', 'A', 'P'};
+inline constexpr uint32_t SNAPSHOT_VERSION = 3;
+inline constexpr uint32_t SNAPSHOT_BYTE_ORDER_MARK = 0x01020304;
+
+// Последовательная запись снимка в файл
+class SnapshotWriter {
+public:
+	explicit SnapshotWriter(const std::string & path);
+
+	template <typename T>
+	void Write(const T & value) {
+		static_assert(std::is_trivially_copyable_v<T>);
+		WriteBytes(&value, sizeof(value));
+	}
+	// Записывает длину строки и ее символы
+	void WriteString(std::string_view text);
+	void WriteBytes(const void * data, size_t size);
+	// Дописывает нулевые байты до смещения, кратного alignment
+	void Align(size_t alignment);
+	// Сбрасывает буфер и проверяет, что запись прошла успешно
+	void Finish();
+
+private:
+	std::ofstream out_;
+	size_t offset_ = 0;
+};
+
+// Чтение снимка, отображенного в память. Выход за границы файла считается повреждением
+class SnapshotReader {
+public:
+	explicit SnapshotReader(const std::string & path);
+	~SnapshotReader();
+
+	SnapshotReader(const SnapshotReader &) = delete;
+	SnapshotReader & operator=(const SnapshotReader &) = delete;
+
+	template <typename T>
+	T Read() {
+		static_assert(std::is_trivially_copyable_v<T>);
+		T value;
+		std::memcpy(&value, Take(sizeof(T)), sizeof(T));
+		return value;
+	}
+	// Строка ссылается на отображенный файл и живет, пока жив SnapshotReader
+	std::string_view ReadString();
+	// Возвращает указатель на count выровненных объектов внутри отображения без копирования
+	template <typename T>
+	const T * ReadArray(size_t count) {
+		static_assert(std::is_trivially_copyable_v<T>);
+		Align(alignof(T));
+		if (count > (size_ - offset_) / sizeof(T)) {
+			throw std::runtime_error("Snapshot is corrupted");
+		}
+		return reinterpret_cast<const T *>(Take(count * sizeof(T)));
+	}
+	void Align(size_t alignment);
+	bool IsAtEnd() const;
+
+private:
+	const char * data_ = nullptr;
+	size_t size_ = 0;
+	size_t offset_ = 0;
+	// Отображение или, где его нет, буфер с содержимым файла
+	void * mapping_ = nullptr;
+	std::unique_ptr<char[]> buffer_;
+
+	const char * Take(size_t size);
+};
@@ -0,0 +1,38 @@
+#include "string_arena.h"
+
+#include <algorithm>
+#include <cstring>
+
+StringArena::StringArena(const StringArena & other)
+	: blocks_(other.blocks_)
+	// Свободный хвост последнего блока остается за оригиналом
+	, used_(blocks_.empty() ? 0 : blocks_.back().capacity)
+{}
+
+StringArena & StringArena::operator=(const StringArena & other) {
+	if (this != &other) {
+		StringArena copy(other);
+		*this = std::move(copy);
+	}
+	return *this;
+}
+
+std::string_view StringArena::Store(std::string_view text) {
+	if (blocks_.empty() || blocks_.back().capacity - used_ < text.size()) {
+		const size_t capacity = std::max(BLOCK_SIZE, text.size());
+		blocks_.push_back({std::shared_ptr<char[]>(new char[capacity]), capacity});
+		used_ = 0;
+	}
+	char * destination = blocks_.back().data.get() + used_;
+	std::memcpy(destination, text.data(), text.size());
+	used_ += text.size();
+	return std::string_view(destination, text.size());
+}
+
+size_t StringArena::GetAllocatedSize() const {
+	size_t size = 0;
+	for (const Block & block : blocks_) {
+		size += block.capacity;
+	}
+	return size;
+}
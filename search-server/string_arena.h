@@ -0,0 +1,34 @@
+#pragma once
+
+#include <memory>
+#include <string_view>
+#include <vector>
+
+// Хранилище строк, выделяющее память крупными блоками вместо отдельной строки на каждое слово.
+// Сохраненные строки не меняют адрес. Копия хранилища делит с оригиналом уже заполненные
+// блоки, а новые строки обе копии пишут в собственные блоки, поэтому string_view,
+// полученные до копирования, остаются действительными в обеих копиях
+class StringArena {
+public:
+	StringArena() = default;
+	StringArena(const StringArena & other);
+	StringArena & operator=(const StringArena & other);
+	StringArena(StringArena && other) = default;
+	StringArena & operator=(StringArena && other) = default;
+
+	// Копирует text в хранилище и возвращает ссылку на копию
+	std::string_view Store(std::string_view text);
+	// Суммарный размер выделенных блоков в байтах
+	size_t GetAllocatedSize() const;
+
+private:
+	static constexpr size_t BLOCK_SIZE = 64 * 1024;
+
+	struct Block {
+		std::shared_ptr<char[]> data;
+		size_t capacity;
+	};
+	std::vector<Block> blocks_;
+	// Занятая часть последнего блока
+	size_t used_ = 0;
+};
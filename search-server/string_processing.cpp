@@ -1,7 +1,63 @@
 #include "string_processing.h"
 
+#include <cstdint>
+#include <cstring>
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
 using std::literals::string_literals::operator""s;
 
+namespace {
+
+bool IsControlChar(char c) {
+	return static_cast<unsigned char>(c) < ' ';
+}
+
+#if defined(__AVX2__) || defined(__SSE2__)
+#if defined(__AVX2__)
+constexpr size_t SIMD_BLOCK_SIZE = 32;
+constexpr uint32_t SIMD_BLOCK_MASK = 0xFFFFFFFF;
+
+// Маски пробелов и управляющих символов блока: бит i соответствует байту i
+void ClassifyBlock(const char * data, uint32_t & spaces, uint32_t & controls) {
+	const __m256i bytes = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(data));
+	spaces = static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(bytes, _mm256_set1_epi8(' '))));
+	// Беззнаковое сравнение с ' ' - 1 через минимум
+	const __m256i low = _mm256_min_epu8(bytes, _mm256_set1_epi8(' ' - 1));
+	controls = static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(low, bytes)));
+}
+#else
+constexpr size_t SIMD_BLOCK_SIZE = 16;
+constexpr uint32_t SIMD_BLOCK_MASK = 0xFFFF;
+
+// Маски пробелов и управляющих символов блока: бит i соответствует байту i
+void ClassifyBlock(const char * data, uint32_t & spaces, uint32_t & controls) {
+	const __m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i *>(data));
+	spaces = static_cast<uint32_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(bytes, _mm_set1_epi8(' '))));
+	// Беззнаковое сравнение с ' ' - 1 через минимум
+	const __m128i low = _mm_min_epu8(bytes, _mm_set1_epi8(' ' - 1));
+	controls = static_cast<uint32_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(low, bytes)));
+}
+#endif
+
+unsigned CountTrailingZeros(uint32_t mask) {
+#if defined(__GNUC__) || defined(__clang__)
+	return static_cast<unsigned>(__builtin_ctz(mask));
+#else
+	unsigned count = 0;
+	for (; (mask & 1) == 0; mask >>= 1) {
+		++count;
+	}
+	return count;
+#endif
+}
+#endif
+
+} // namespace
+
 std::vector<std::string> SplitIntoWords(const std::string & text) {
 	std::vector<std::string> words;
 	std::string word = ""s;
@@ -23,16 +79,84 @@ std::vector<std::string> SplitIntoWords(const std::string & text) {
 
 std::vector<std::string_view> SplitIntoWordsView(std::string_view str) {
 	std::vector<std::string_view> result;
+	SplitIntoWordsView(str, result);
+	return result;
+}
+
+void SplitIntoWordsView(std::string_view str, std::vector<std::string_view> & words) {
+	words.clear();
 	str.remove_prefix(std::min(str.find_first_not_of(' '), str.size()));
 
 	while (str.size() > 0) {
 		auto space = str.find(' ');
-		result.push_back(str.substr(0, space));
+		words.push_back(str.substr(0, space));
 		str.remove_prefix(std::min(str.find_first_not_of(' ', space), str.size()));
 	}
-
-	return result;
 }
 
+bool SplitIntoValidWordsViewScalar(std::string_view text, std::vector<std::string_view> & words) {
+	words.clear();
+	size_t word_begin = 0;
+	bool in_word = false;
+	for (size_t i = 0; i < text.size(); ++i) {
+		const char c = text[i];
+		if (IsControlChar(c)) {
+			return false;
+		}
+		if (c == ' ') {
+			if (in_word) {
+				words.push_back(text.substr(word_begin, i - word_begin));
+				in_word = false;
+			}
+		} else if (!in_word) {
+			word_begin = i;
+			in_word = true;
+		}
+	}
+	if (in_word) {
+		words.push_back(text.substr(word_begin));
+	}
+	return true;
+}
 
-
+bool SplitIntoValidWordsView(std::string_view text, std::vector<std::string_view> & words) {
+#if defined(__AVX2__) || defined(__SSE2__)
+	words.clear();
+	size_t word_begin = 0;
+	bool in_word = false;
+	for (size_t offset = 0; offset < text.size(); offset += SIMD_BLOCK_SIZE) {
+		uint32_t spaces;
+		uint32_t controls;
+		if (offset + SIMD_BLOCK_SIZE <= text.size()) {
+			ClassifyBlock(text.data() + offset, spaces, controls);
+		} else {
+			// Хвост строки дополняется пробелами, которые заодно завершают последнее слово
+			char block[SIMD_BLOCK_SIZE];
+			std::memset(block, ' ', SIMD_BLOCK_SIZE);
+			std::memcpy(block, text.data() + offset, text.size() - offset);
+			ClassifyBlock(block, spaces, controls);
+		}
+		if (controls != 0) {
+			return false;
+		}
+		// Биты changes отмечают границы слов: первый символ слова и первый пробел после него
+		const uint32_t letters = ~spaces & SIMD_BLOCK_MASK;
+		uint32_t changes = (letters ^ ((letters << 1) | (in_word ? 1u : 0u))) & SIMD_BLOCK_MASK;
+		for (; changes != 0; changes &= changes - 1) {
+			const size_t position = offset + CountTrailingZeros(changes);
+			if (in_word) {
+				words.push_back(text.substr(word_begin, position - word_begin));
+			} else {
+				word_begin = position;
+			}
+			in_word = !in_word;
+		}
+	}
+	if (in_word) {
+		words.push_back(text.substr(word_begin));
+	}
+	return true;
+#else
+	return SplitIntoValidWordsViewScalar(text, words);
+#endif
+}
@@ -8,6 +8,16 @@
 //Разбивает строку на массив строк, разделитель пробел(ы)
 std::vector<std::string> SplitIntoWords(const std::string & text);
 std::vector<std::string_view> SplitIntoWordsView(std::string_view str);
+// То же в переданный массив, емкость которого переиспользуется
+void SplitIntoWordsView(std::string_view str, std::vector<std::string_view> & words);
+
+// Разбивает строку на слова по пробелам и за тот же проход проверяет, что в ней нет
+// управляющих символов (коды меньше пробела). Слова записываются в words, массив очищается.
+// Возвращает false, если управляющий символ найден, тогда words заполнен не полностью.
+// Версия с SIMD просматривает строку блоками по 32 байта с AVX2 или по 16 байт с SSE2,
+// если компилятор их поддерживает, иначе совпадает со скалярной
+bool SplitIntoValidWordsView(std::string_view text, std::vector<std::string_view> & words);
+bool SplitIntoValidWordsViewScalar(std::string_view text, std::vector<std::string_view> & words);
 
 //Сортирует и удаляет дубликаты в векторе строк
 template <typename ExecutionPolicy, typename Container>
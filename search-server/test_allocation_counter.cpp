@@ -0,0 +1,61 @@
+#include "test_allocation_counter.h"
+
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+namespace {
+std::atomic<size_t> allocation_count{0};
+}
+
+// Глобальные operator new и operator delete заменены, чтобы тесты могли считать выделения памяти.
+// Замена действует на всю программу, поэтому она вынесена из движка тестов в отдельный файл,
+// и сборка без тестов его не подключает. Формы для массивов заменены явно: библиотеки могут подменять их отдельно (например, санитайзер)
+void * operator new(std::size_t size) {
+	allocation_count.fetch_add(1, std::memory_order_relaxed);
+	if (void * pointer = std::malloc(size == 0 ? 1 : size)) {
+		return pointer;
+	}
+	throw std::bad_alloc();
+}
+
+void * operator new[](std::size_t size) {
+	return operator new(size);
+}
+
+void * operator new(std::size_t size, const std::nothrow_t &) noexcept {
+	allocation_count.fetch_add(1, std::memory_order_relaxed);
+	return std::malloc(size == 0 ? 1 : size);
+}
+
+void * operator new[](std::size_t size, const std::nothrow_t & tag) noexcept {
+	return operator new(size, tag);
+}
+
+void operator delete(void * pointer) noexcept {
+	std::free(pointer);
+}
+
+void operator delete(void * pointer, std::size_t) noexcept {
+	std::free(pointer);
+}
+
+void operator delete[](void * pointer) noexcept {
+	std::free(pointer);
+}
+
+void operator delete[](void * pointer, std::size_t) noexcept {
+	std::free(pointer);
+}
+
+void operator delete(void * pointer, const std::nothrow_t &) noexcept {
+	std::free(pointer);
+}
+
+void operator delete[](void * pointer, const std::nothrow_t &) noexcept {
+	std::free(pointer);
+}
+
+size_t GetAllocationCount() {
+	return allocation_count.load(std::memory_order_relaxed);
+}
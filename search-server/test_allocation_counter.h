@@ -0,0 +1,6 @@
+#pragma once
+
+#include <cstddef>
+
+// Число выделений памяти через глобальный operator new с запуска программы во всех потоках
+size_t GetAllocationCount();
@@ -0,0 +1,200 @@
+#include "test_concurrent_search_server.h"
+#include "concurrent_search_server.h"
+#include "query_generator.h"
+#include "test_engine.h"
+#include <atomic>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+using std::literals::string_literals::operator""s;
+
+// Сравнивает выдачу двух серверов на наборе запросов
+void AssertSameSearchResults(const SearchServer & lhs, const SearchServer & rhs,
+	const std::vector<std::string> & queries)
+{
+	ASSERT_EQUAL(lhs.GetDocumentCount(), rhs.GetDocumentCount());
+	for (const std::string & query : queries) {
+		const auto lhs_documents = lhs.FindTopDocuments(query);
+		const auto rhs_documents = rhs.FindTopDocuments(query);
+		ASSERT_EQUAL_HINT(lhs_documents.size(), rhs_documents.size(), query);
+		for (size_t i = 0; i < lhs_documents.size(); ++i) {
+			ASSERT_EQUAL_HINT(lhs_documents[i].id, rhs_documents[i].id, query);
+			ASSERT_EQUAL_HINT(lhs_documents[i].relevance, rhs_documents[i].relevance, query);
+		}
+	}
+}
+
+// Проверяет, что изменения видны только после публикации, а взятый снимок не меняется
+void TestSnapshotIsolation() {
+	ConcurrentSearchServer server(SearchServer("and in"s));
+	server.AddDocument(1, "white cat and fancy collar"s, DocumentStatus::ACTUAL, {8, -3});
+	ASSERT_EQUAL(server.GetDocumentCount(), 0);
+	ASSERT_EQUAL(server.GetVersion(), 0u);
+	server.Publish();
+	ASSERT_EQUAL(server.GetDocumentCount(), 1);
+	ASSERT_EQUAL(server.GetVersion(), 1u);
+	// Публикация без изменений не создает версию
+	server.Publish();
+	ASSERT_EQUAL(server.GetVersion(), 1u);
+
+	const ConcurrentSearchServer::Snapshot snapshot = server.GetSnapshot();
+	server.AddDocument(2, "fluffy cat fluffy tail"s, DocumentStatus::ACTUAL, {7, 2, 7});
+	server.RemoveDocument(1);
+	server.Publish();
+	ASSERT_EQUAL(snapshot->GetDocumentCount(), 1);
+	ASSERT_EQUAL(snapshot->FindTopDocuments("cat"s).at(0).id, 1);
+	ASSERT_EQUAL(server.FindTopDocuments("cat"s).size(), 1u);
+	ASSERT_EQUAL(server.FindTopDocuments("cat"s).at(0).id, 2);
+
+	const auto [words, status] = snapshot->MatchDocument("white cat"s, 1);
+	ASSERT_EQUAL(words.size(), 2u);
+	ASSERT(status == DocumentStatus::ACTUAL);
+}
+
+// Проверяет, что копия писателя, догнанная повторением изменений, и полная копия
+// совпадают с сервером, измененным напрямую
+void TestWriterCopyMatchesDirectChanges() {
+	std::mt19937 generator;
+	const auto dictionary = GenerateDictionary(generator, 200, 6);
+	const auto texts = GenerateQueries(generator, dictionary, 1'200, 15);
+	const auto queries = GenerateQueries(generator, dictionary, 30, 4);
+
+	SearchServer expected(dictionary[0]);
+	ConcurrentSearchServer server(SearchServer{dictionary[0]});
+	ConcurrentSearchServer::Snapshot held;
+	int id = 0;
+	for (int round = 0; round < 12; ++round) {
+		// В нечетных раундах старый снимок удерживается, и писатель копирует сервер целиком
+		held = round % 2 == 1 ? server.GetSnapshot() : nullptr;
+		for (int i = 0; i < 100; ++i, ++id) {
+			expected.AddDocument(id, texts[id], DocumentStatus::ACTUAL, {id % 5});
+			server.AddDocument(id, texts[id], DocumentStatus::ACTUAL, {id % 5});
+		}
+		for (int removed = round * 100; removed < id; removed += 3 + round) {
+			expected.RemoveDocument(removed);
+			server.RemoveDocument(removed);
+		}
+		// Неудачное изменение не повторяется на второй копии
+		bool is_rejected = false;
+		try {
+			server.AddDocument(1, "duplicate id"s, DocumentStatus::ACTUAL, {});
+		} catch (const std::invalid_argument &) {
+			is_rejected = true;
+		}
+		ASSERT(is_rejected);
+		server.Update([round](SearchServer & search_server) {
+			search_server.SetDocumentSet("round"s, {round * 100 + 1});
+		});
+		expected.SetDocumentSet("round"s, {round * 100 + 1});
+		server.Publish();
+		AssertSameSearchResults(expected, *server.GetSnapshot(), queries);
+	}
+	SearchOptions options;
+	options.document_sets = {"round"s};
+	ASSERT_EQUAL(server.FindTopDocuments(texts[1'101], DocumentStatus::ACTUAL, options).size(), 1u);
+}
+
+// Проверяет, что сжатие в отдельном потоке не теряет изменений писателя, сделанных
+// во время сжатия, и что после публикации сжатый сервер остается сжатым
+void TestBackgroundCompaction() {
+	std::mt19937 generator;
+	const auto dictionary = GenerateDictionary(generator, 200, 6);
+	const auto texts = GenerateQueries(generator, dictionary, 1'000, 15);
+	const auto queries = GenerateQueries(generator, dictionary, 30, 4);
+
+	SearchServer expected(dictionary[0]);
+	ConcurrentSearchServer server(SearchServer{dictionary[0]});
+	for (int id = 0; id < 600; ++id) {
+		expected.AddDocument(id, texts[id], DocumentStatus::ACTUAL, {id % 5});
+		server.AddDocument(id, texts[id], DocumentStatus::ACTUAL, {id % 5});
+	}
+	for (int id = 0; id < 400; ++id) {
+		expected.RemoveDocument(id);
+		server.RemoveDocument(id);
+	}
+	server.Publish();
+	ASSERT(server.GetSnapshot()->NeedsCompaction());
+	// Неопубликованное изменение тоже попадает в сжатую копию
+	expected.RemoveDocument(400);
+	server.RemoveDocument(400);
+
+	std::thread compactor([&server]() {
+		server.Compact();
+	});
+	for (int id = 600; id < 800; ++id) {
+		expected.AddDocument(id, texts[id], DocumentStatus::ACTUAL, {id % 5});
+		server.AddDocument(id, texts[id], DocumentStatus::ACTUAL, {id % 5});
+		if (id % 50 == 0) {
+			server.Publish();
+		}
+	}
+	compactor.join();
+	for (int id = 401; id < 450; ++id) {
+		expected.RemoveDocument(id);
+		server.RemoveDocument(id);
+	}
+	server.Publish();
+	AssertSameSearchResults(expected, *server.GetSnapshot(), queries);
+	ASSERT(!server.GetSnapshot()->NeedsCompaction());
+
+	// Следующая копия писателя получается из сжатой версии
+	for (int id = 800; id < 1'000; ++id) {
+		expected.AddDocument(id, texts[id], DocumentStatus::ACTUAL, {id % 5});
+		server.AddDocument(id, texts[id], DocumentStatus::ACTUAL, {id % 5});
+		server.Publish();
+	}
+	AssertSameSearchResults(expected, *server.GetSnapshot(), queries);
+	ASSERT(!server.GetSnapshot()->NeedsCompaction());
+}
+
+// Проверяет, что читатели во время изменений видят только целые опубликованные версии
+void TestReadersDuringUpdates() {
+	std::mt19937 generator;
+	const auto dictionary = GenerateDictionary(generator, 200, 6);
+	const auto texts = GenerateQueries(generator, dictionary, 2'000, 15);
+	ConcurrentSearchServer server(SearchServer{dictionary[0]});
+
+	constexpr int BATCH_SIZE = 50;
+	std::atomic<bool> is_done = false;
+	std::atomic<int> failures = 0;
+	std::vector<std::thread> readers;
+	for (int reader = 0; reader < 3; ++reader) {
+		readers.emplace_back([&, reader]() {
+			int previous_count = 0;
+			for (size_t i = reader; !is_done; ++i) {
+				const ConcurrentSearchServer::Snapshot snapshot = server.GetSnapshot();
+				const int count = snapshot->GetDocumentCount();
+				if (count % BATCH_SIZE != 0 || count < previous_count) {
+					++failures;
+				}
+				previous_count = count;
+				for (const Document & document : snapshot->FindTopDocuments(texts[i % texts.size()])) {
+					if (document.id >= count) {
+						++failures;
+					}
+				}
+			}
+		});
+	}
+	for (int id = 0; id < static_cast<int>(texts.size()); ++id) {
+		server.AddDocument(id, texts[id], DocumentStatus::ACTUAL, {1});
+		if ((id + 1) % BATCH_SIZE == 0) {
+			server.Publish();
+		}
+	}
+	is_done = true;
+	for (std::thread & reader : readers) {
+		reader.join();
+	}
+	ASSERT_EQUAL(failures.load(), 0);
+	ASSERT_EQUAL(server.GetDocumentCount(), static_cast<int>(texts.size()));
+}
+
+void TestConcurrentSearchServer() {
+	RUN_TEST(TestSnapshotIsolation);
+	RUN_TEST(TestWriterCopyMatchesDirectChanges);
+	RUN_TEST(TestReadersDuringUpdates);
+	RUN_TEST(TestBackgroundCompaction);
+}
@@ -0,0 +1,447 @@
+#include "test_inverted_index.h"
+#include "document_bitmap.h"
+#include "inverted_index.h"
+#include "test_engine.h"
+#include <cmath>
+#include <string>
+#include <vector>
+
+using std::literals::string_literals::operator""s;
+
+// Проверяет, что словарь выдает одному слову один и тот же плотный id
+void TestTermDictionary() {
+	InvertedIndex index;
+	ASSERT(!index.FindTerm("cat"s));
+
+	const InvertedIndex::TermId cat = index.AddTerm("cat"s);
+	const InvertedIndex::TermId dog = index.AddTerm("dog"s);
+	ASSERT_EQUAL(cat, 0u);
+	ASSERT_EQUAL(dog, 1u);
+	ASSERT_EQUAL(index.AddTerm("cat"s), cat);
+	ASSERT_EQUAL(index.GetTermCount(), 2u);
+	ASSERT_EQUAL(*index.FindTerm("dog"s), dog);
+
+	// Слово хранится в словаре, а не в переданной строке
+	std::string word = "lion"s;
+	const InvertedIndex::TermId lion = index.AddTerm(word);
+	word = "tiger"s;
+	ASSERT_EQUAL(index.GetTerm(lion), "lion"s);
+}
+
+// Проверяет, что списки вхождений упорядочены по номеру документа
+void TestPostingListOrder() {
+	InvertedIndex index;
+	const InvertedIndex::TermId cat = index.AddTerm("cat"s);
+	index.AddPosting(cat, 5, 0.5);
+	index.AddPosting(cat, 1, 0.25);
+	index.AddPosting(cat, 3, 0.25);
+	index.AddPosting(cat, 3, 0.25);
+
+	const PostingList & postings = index.GetPostings(cat);
+	ASSERT_EQUAL(postings.GetSize(), 3u);
+	std::vector<DocumentOrdinal> ordinals;
+	postings.ForEach(0, PostingList::NO_ORDINAL, [&ordinals](DocumentOrdinal ordinal, double) {
+		ordinals.push_back(ordinal);
+	});
+	ASSERT_EQUAL(ordinals, (std::vector<DocumentOrdinal>{1, 3, 5}));
+	ASSERT_EQUAL(index.GetMaxTf(cat), 0.5);
+
+	// Отрезок номеров [2, 5) содержит только документ 3
+	PostingList::Cursor cursor = index.GetCursor(cat, 2, 5);
+	ASSERT_EQUAL(cursor.GetOrdinal(), 3u);
+	ASSERT_EQUAL(cursor.GetTf(), 0.5);
+	cursor.Next();
+	ASSERT(cursor.IsEnd());
+
+	ASSERT(index.HasPosting(cat, 3));
+	index.RemovePosting(cat, 3);
+	ASSERT(!index.HasPosting(cat, 3));
+	ASSERT_EQUAL(postings.GetSize(), 2u);
+
+	// Удаление отсутствующего документа ничего не меняет
+	index.RemovePosting(cat, 42);
+	ASSERT_EQUAL(postings.GetSize(), 2u);
+	// После удаления документа с наибольшим tf граница пересчитывается
+	ASSERT_EQUAL(index.GetMaxTf(cat), 0.5);
+	index.RemovePosting(cat, 5);
+	ASSERT_EQUAL(index.GetMaxTf(cat), 0.25);
+}
+
+// Проверяет сжатые блоки: разности разной ширины, пропуски блоков и изменение в середине списка
+void TestCompressedPostings() {
+	std::vector<PostingList::Posting> expected;
+	DocumentOrdinal ordinal = 0;
+	for (int i = 0; i < 1000; ++i) {
+		// Участки с разностями шириной 3, 10-11 и 17 бит
+		ordinal += i < 400 ? 1 + i % 7 : i < 700 ? 300 + i : 70'000;
+		expected.push_back({ordinal, PostingList::QuantizeTf(1.0 / (1 + i % 10))});
+	}
+	PostingList postings;
+	for (const auto & posting : expected) {
+		postings.Add(posting.ordinal, posting.tf);
+	}
+	ASSERT_EQUAL(postings.GetSize(), expected.size());
+	ASSERT_EQUAL(postings.GetMaxTf(), 1.0);
+
+	const auto check = [&postings](const std::vector<PostingList::Posting> & expected) {
+		size_t index = 0;
+		postings.ForEach(0, PostingList::NO_ORDINAL, [&](DocumentOrdinal ordinal, double tf) {
+			ASSERT(index < expected.size());
+			ASSERT_EQUAL(ordinal, expected[index].ordinal);
+			ASSERT_EQUAL(tf, expected[index].tf);
+			++index;
+		});
+		ASSERT_EQUAL(index, expected.size());
+	};
+	check(expected);
+
+	// Курсор по отрезку с пропусками через несколько блоков
+	PostingList::Cursor cursor(postings, expected[100].ordinal, expected[900].ordinal);
+	ASSERT_EQUAL(cursor.GetOrdinal(), expected[100].ordinal);
+	for (size_t i : {101u, 150u, 500u, 501u, 899u}) {
+		cursor.SkipTo(expected[i - 1].ordinal + 1);
+		ASSERT_EQUAL(cursor.GetOrdinal(), expected[i].ordinal);
+		ASSERT_EQUAL(cursor.GetTf(), expected[i].tf);
+	}
+	cursor.Next();
+	ASSERT(cursor.IsEnd());
+	ASSERT_EQUAL(cursor.GetOrdinal(), PostingList::NO_ORDINAL);
+
+	// Подсчет вхождений отрезка с границами внутри блоков и в несжатом хвосте
+	ASSERT_EQUAL(postings.CountInRange(0, PostingList::NO_ORDINAL), expected.size());
+	ASSERT_EQUAL(postings.CountInRange(expected[100].ordinal, expected[900].ordinal), 800u);
+	ASSERT_EQUAL(postings.CountInRange(expected[130].ordinal + 1, expected[995].ordinal), 864u);
+	ASSERT_EQUAL(postings.CountInRange(expected[999].ordinal + 1, PostingList::NO_ORDINAL), 0u);
+	ASSERT_EQUAL(postings.CountInRange(expected[5].ordinal, expected[5].ordinal), 0u);
+
+	// Удаление и вставка в сжатой части
+	postings.Remove(expected[300].ordinal);
+	expected.erase(expected.begin() + 300);
+	postings.Add(2, 2.0);
+	expected.insert(expected.begin() + 1, {2, 2.0});
+	check(expected);
+	ASSERT_EQUAL(postings.GetMaxTf(), 2.0);
+	ASSERT_EQUAL(postings.GetSize(), expected.size());
+
+	// Сжатый список заметно меньше массива пар (номер, tf)
+	ASSERT(postings.GetMemoryUsage() < expected.size() * sizeof(PostingList::Posting) / 2);
+
+	// Частое слово в документах нескольких длин: разности в 3 бита, tf из таблицы блока.
+	// Вместе с заголовками блоков около байта на вхождение вместо 16 байт пары (номер, tf)
+	std::vector<PostingList::Posting> frequent;
+	for (DocumentOrdinal ordinal = 0; frequent.size() < 100'000; ordinal += 1 + ordinal % 5) {
+		frequent.push_back({ordinal, 1.0 / (10 + ordinal % 4)});
+	}
+	PostingList frequent_postings;
+	frequent_postings.Assign(frequent.data(), frequent.data() + frequent.size());
+	ASSERT(frequent_postings.GetMemoryUsage() < frequent.size() * 3 / 2);
+	ASSERT(frequent_postings.Contains(frequent[77'777].ordinal));
+}
+
+// Проверяет, что векторная распаковка чисел и разностей совпадает со скалярной
+void TestDecodeOrdinals() {
+	std::vector<uint8_t> packed(4 * 300 + PostingList::PADDING);
+	for (size_t i = 0; i < packed.size(); ++i) {
+		packed[i] = static_cast<uint8_t>(i * 37 + 11);
+	}
+	for (uint8_t bits = 0; bits <= 32; ++bits) {
+		for (size_t count = 0; count <= 300; ++count) {
+			const std::string hint = "bits: "s + std::to_string(bits) + " count: "s + std::to_string(count);
+			std::vector<uint32_t> simd_values(count);
+			std::vector<uint32_t> scalar_values(count);
+			UnpackBits(packed.data(), bits, count, simd_values.data());
+			UnpackBitsScalar(packed.data(), bits, count, scalar_values.data());
+			ASSERT_EQUAL_HINT(simd_values, scalar_values, hint);
+			for (const uint32_t value : scalar_values) {
+				ASSERT_HINT(bits == 32 || value < (uint32_t{1} << bits), hint);
+			}
+
+			std::vector<DocumentOrdinal> simd(count);
+			std::vector<DocumentOrdinal> scalar(count);
+			DecodeOrdinals(packed.data(), bits, count, 42, simd.data());
+			DecodeOrdinalsScalar(packed.data(), bits, count, 42, scalar.data());
+			ASSERT_EQUAL_HINT(simd, scalar, hint);
+		}
+	}
+}
+
+// Проверяет множество номеров в обоих представлениях участков и пересечение множеств
+void TestDocumentBitmap() {
+	DocumentBitmap even;
+	DocumentBitmap thirds;
+	std::vector<DocumentOrdinal> expected;
+	// Первый участок плотный, второй разреженный
+	for (DocumentOrdinal ordinal = 0; ordinal < 70'000; ++ordinal) {
+		if (ordinal % 2 == 0 && (ordinal < 65'536 || ordinal % 64 == 0)) {
+			even.Add(ordinal);
+		}
+		if (ordinal % 3 == 0) {
+			thirds.Add(ordinal);
+		}
+		if (ordinal % 6 == 0 && (ordinal < 65'536 || ordinal % 64 == 0)) {
+			expected.push_back(ordinal);
+		}
+	}
+	even.Add(0);
+	ASSERT_EQUAL(even.GetCardinality(), 32'768u + 70u);
+	ASSERT(even.Contains(65'536 + 64));
+	ASSERT(!even.Contains(65'536 + 2));
+	ASSERT(even.GetMemoryUsage() < 70'000 / 8 + 1'000);
+
+	const DocumentBitmap both = DocumentBitmap::Intersect(even, thirds);
+	std::vector<DocumentOrdinal> ordinals;
+	both.ForEach([&ordinals](DocumentOrdinal ordinal) {
+		ordinals.push_back(ordinal);
+	});
+	ASSERT_EQUAL(ordinals, expected);
+	ASSERT_EQUAL(both.GetCardinality(), expected.size());
+
+	// После удаления плотный участок становится массивом, пустой участок исчезает
+	for (DocumentOrdinal ordinal = 0; ordinal < 60'000; ++ordinal) {
+		even.Remove(ordinal);
+	}
+	for (DocumentOrdinal ordinal = 65'536; ordinal < 70'000; ++ordinal) {
+		even.Remove(ordinal);
+	}
+	ASSERT_EQUAL(even.GetCardinality(), (65'536u - 60'000u) / 2);
+	ASSERT(even.Contains(60'000));
+	ASSERT(!even.Contains(59'998));
+	std::vector<DocumentOrdinal> new_ordinals(65'536, 0);
+	for (DocumentOrdinal ordinal = 60'000; ordinal < 65'536; ++ordinal) {
+		new_ordinals[ordinal] = ordinal - 60'000;
+	}
+	even.Remap(new_ordinals);
+	ASSERT_EQUAL(even.GetCardinality(), (65'536u - 60'000u) / 2);
+	ASSERT(even.Contains(0));
+	ASSERT(!even.Contains(1));
+	ASSERT(even.Contains(2));
+
+	// Пакетное удаление из плотного и разреженного участков с номерами, которых нет в множестве
+	std::vector<DocumentOrdinal> removed;
+	for (DocumentOrdinal ordinal = 0; ordinal < 70'000; ordinal += 2) {
+		removed.push_back(ordinal);
+	}
+	DocumentBitmap expected_thirds;
+	thirds.ForEach([&expected_thirds](DocumentOrdinal ordinal) {
+		if (ordinal % 2 != 0) {
+			expected_thirds.Add(ordinal);
+		}
+	});
+	thirds.RemoveSorted(removed);
+	ASSERT_EQUAL(thirds.GetCardinality(), expected_thirds.GetCardinality());
+	std::vector<DocumentOrdinal> left;
+	thirds.ForEach([&left](DocumentOrdinal ordinal) {
+		left.push_back(ordinal);
+	});
+	std::vector<DocumentOrdinal> expected_left;
+	expected_thirds.ForEach([&expected_left](DocumentOrdinal ordinal) {
+		expected_left.push_back(ordinal);
+	});
+	ASSERT_EQUAL(left, expected_left);
+	// Разреженный участок пустеет и исчезает
+	DocumentBitmap sparse;
+	sparse.Add(70'000);
+	sparse.Add(70'010);
+	sparse.RemoveSorted({5, 70'000, 70'010, 200'000});
+	ASSERT(sparse.IsEmpty());
+	ASSERT(!sparse.Contains(70'010));
+}
+
+// Проверяет, что кэш idf обновляется при смене числа документов
+void TestIdfCache() {
+	InvertedIndex index;
+	const InvertedIndex::TermId cat = index.AddTerm("cat"s);
+	index.AddPosting(cat, 0, 1.0);
+	index.AddPosting(cat, 1, 1.0);
+	index.SetDocumentCount(4);
+	ASSERT_EQUAL(index.GetIdf(cat), std::log(2.0));
+	ASSERT_EQUAL(index.GetIdf(cat), std::log(2.0));
+
+	InvertedIndex copied_index = index;
+	ASSERT_EQUAL(copied_index.GetIdf(cat), std::log(2.0));
+
+	index.AddPosting(cat, 2, 1.0);
+	index.AddPosting(cat, 3, 1.0);
+	index.SetDocumentCount(8);
+	ASSERT_EQUAL(index.GetIdf(cat), std::log(2.0));
+	index.RemovePosting(cat, 3);
+	index.SetDocumentCount(6);
+	ASSERT_EQUAL(index.GetIdf(cat), std::log(2.0));
+	index.SetDocumentCount(3);
+	ASSERT_EQUAL(index.GetIdf(cat), 0.0);
+	// Копия живет в своей эпохе
+	ASSERT_EQUAL(copied_index.GetIdf(cat), std::log(2.0));
+}
+
+// Проверяет перенумерацию документов с сохранением порядка
+void TestRemapOrdinals() {
+	InvertedIndex index;
+	const InvertedIndex::TermId cat = index.AddTerm("cat"s);
+	index.AddPosting(cat, 2, 0.5);
+	index.AddPosting(cat, 7, 0.25);
+
+	std::vector<DocumentOrdinal> new_ordinals(8, 0);
+	new_ordinals[2] = 0;
+	new_ordinals[7] = 1;
+	index.RemapOrdinals(new_ordinals);
+	ASSERT(index.HasPosting(cat, 0));
+	ASSERT(index.HasPosting(cat, 1));
+	ASSERT(!index.HasPosting(cat, 7));
+}
+
+// Проверяет учет удаленных вхождений до сжатия и их выбрасывание при перенумерации
+void TestRemovedPostings() {
+	InvertedIndex index;
+	const InvertedIndex::TermId cat = index.AddTerm("cat"s);
+	for (DocumentOrdinal ordinal = 0; ordinal < 4; ++ordinal) {
+		index.AddPosting(cat, ordinal, 1.0);
+	}
+	index.SetDocumentCount(4);
+	ASSERT_EQUAL(index.GetDocumentFrequency(cat), 4u);
+
+	index.MarkPostingRemoved(cat);
+	index.MarkPostingRemoved(cat);
+	index.SetDocumentCount(4);
+	ASSERT_EQUAL(index.GetDocumentFrequency(cat), 2u);
+	ASSERT_EQUAL(index.GetIdf(cat), std::log(2.0));
+	// Вхождение остается в списке до перенумерации
+	ASSERT(index.HasPosting(cat, 1));
+
+	std::vector<DocumentOrdinal> new_ordinals = {0, PostingList::NO_ORDINAL, PostingList::NO_ORDINAL, 1};
+	index.RemapOrdinals(new_ordinals);
+	ASSERT_EQUAL(index.GetPostings(cat).GetSize(), 2u);
+	ASSERT_EQUAL(index.GetDocumentFrequency(cat), 2u);
+	ASSERT(index.HasPosting(cat, 0));
+	ASSERT(index.HasPosting(cat, 1));
+	ASSERT(!index.HasPosting(cat, 3));
+}
+
+// Проверяет очистку списка, в котором удаленных вхождений стало больше живых,
+// и перенумерацию, не трогающую списки до первого удаленного документа
+void TestPurgeRemovedPostings() {
+	InvertedIndex index;
+	const InvertedIndex::TermId cat = index.AddTerm("cat"s);
+	const InvertedIndex::TermId dog = index.AddTerm("dog"s);
+	for (DocumentOrdinal ordinal = 0; ordinal < 5; ++ordinal) {
+		index.AddPosting(cat, ordinal, 1.0);
+	}
+	index.AddPosting(dog, 0, 0.5);
+	index.AddPosting(dog, 1, 0.5);
+
+	// Очистка нужна один раз, при переходе через половину списка
+	ASSERT(!index.MarkPostingRemoved(cat));
+	ASSERT(!index.MarkPostingRemoved(cat));
+	ASSERT(index.MarkPostingRemoved(cat));
+	ASSERT(!index.MarkPostingRemoved(cat));
+
+	const std::vector<bool> is_live = {true, true, false, false, false};
+	index.PurgeRemovedPostings(cat, [&is_live](DocumentOrdinal ordinal) {
+		return is_live[ordinal];
+	});
+	ASSERT_EQUAL(index.GetPostings(cat).GetSize(), 2u);
+	ASSERT_EQUAL(index.GetDocumentFrequency(cat), 2u);
+	ASSERT(index.HasPosting(cat, 1));
+	ASSERT(!index.HasPosting(cat, 2));
+
+	// Номера 0 и 1 не меняются, поэтому список dog не перестраивается
+	const std::vector<DocumentOrdinal> new_ordinals = {0, 1,
+		PostingList::NO_ORDINAL, PostingList::NO_ORDINAL, PostingList::NO_ORDINAL};
+	const size_t dog_memory = index.GetPostings(dog).GetMemoryUsage();
+	index.RemapOrdinals(new_ordinals);
+	ASSERT_EQUAL(index.GetPostings(dog).GetMemoryUsage(), dog_memory);
+	ASSERT(index.HasPosting(dog, 0));
+	ASSERT(index.HasPosting(dog, 1));
+	ASSERT_EQUAL(index.GetPostings(cat).GetSize(), 2u);
+}
+
+// Проверяет, что слова без вхождений выбрасываются из словаря, а оставшиеся получают id подряд
+void TestPurgeEmptyTerms() {
+	InvertedIndex index;
+	const InvertedIndex::TermId cat = index.AddTerm("cat"s);
+	const InvertedIndex::TermId dog = index.AddTerm("dog"s);
+	const InvertedIndex::TermId fox = index.AddTerm("fox"s);
+	index.AddPosting(cat, 0, 1.0);
+	index.AddPosting(dog, 1, 0.5);
+	index.AddPosting(fox, 1, 0.5);
+	index.SetDocumentCount(2);
+	ASSERT_EQUAL(index.GetIdf(fox), std::log(2.0));
+	ASSERT_EQUAL(index.GetEmptyTermCount(), 0u);
+
+	index.RemapOrdinals({PostingList::NO_ORDINAL, 0});
+	index.SetDocumentCount(1);
+	ASSERT_EQUAL(index.GetEmptyTermCount(), 1u);
+
+	const std::vector<InvertedIndex::TermId> new_term_ids = index.PurgeEmptyTerms();
+	ASSERT_EQUAL(new_term_ids.size(), 3u);
+	ASSERT_EQUAL(new_term_ids[cat], InvertedIndex::NO_TERM);
+	ASSERT_EQUAL(new_term_ids[dog], 0u);
+	ASSERT_EQUAL(new_term_ids[fox], 1u);
+	ASSERT_EQUAL(index.GetTermCount(), 2u);
+	ASSERT_EQUAL(index.GetEmptyTermCount(), 0u);
+	ASSERT(!index.FindTerm("cat"s));
+	ASSERT_EQUAL(*index.FindTerm("fox"s), 1u);
+	ASSERT_EQUAL(index.GetTerm(0), "dog"s);
+	ASSERT(index.HasPosting(1, 0));
+	ASSERT_EQUAL(index.GetDocumentFrequency(1), 1u);
+	ASSERT_EQUAL(index.GetIdf(1), 0.0);
+
+	// Новое слово получает следующий id
+	ASSERT_EQUAL(index.AddTerm("cat"s), 2u);
+}
+
+// Проверяет, что строки хранилища не перемещаются и переживают копирование
+void TestStringArena() {
+	StringArena arena;
+	const std::string_view cat = arena.Store("cat"s);
+	std::vector<std::string_view> words;
+	for (int i = 0; i < 20'000; ++i) {
+		words.push_back(arena.Store(std::to_string(i)));
+	}
+	// Строка длиннее блока получает отдельный блок
+	const std::string long_word(100'000, 'a');
+	const std::string_view long_view = arena.Store(long_word);
+	ASSERT_EQUAL(cat, "cat"s);
+	ASSERT_EQUAL(long_view, long_word);
+	for (int i = 0; i < 20'000; ++i) {
+		ASSERT_EQUAL(words[i], std::to_string(i));
+	}
+	ASSERT(arena.GetAllocatedSize() >= long_word.size());
+
+	std::string_view copied_word;
+	{
+		StringArena copy = arena;
+		copied_word = copy.Store("lion"s);
+		// Оригинал пишет в свой блок и не затирает строки копии
+		const std::string_view original_word = arena.Store("tiger"s);
+		ASSERT_EQUAL(copied_word, "lion"s);
+		ASSERT_EQUAL(original_word, "tiger"s);
+		ASSERT_EQUAL(copy.Store("dog"s), "dog"s);
+		ASSERT_EQUAL(copied_word, "lion"s);
+	}
+	// Блоки, общие с уничтоженной копией, остаются у оригинала
+	ASSERT_EQUAL(cat, "cat"s);
+
+	// Копия словаря индекса остается рабочей после уничтожения оригинала
+	InvertedIndex copied_index;
+	{
+		InvertedIndex index;
+		index.AddTerm("cat"s);
+		copied_index = index;
+	}
+	ASSERT_EQUAL(copied_index.GetTerm(*copied_index.FindTerm("cat"s)), "cat"s);
+	ASSERT_EQUAL(copied_index.AddTerm("dog"s), 1u);
+}
+
+void TestInvertedIndex() {
+	RUN_TEST(TestTermDictionary);
+	RUN_TEST(TestPostingListOrder);
+	RUN_TEST(TestCompressedPostings);
+	RUN_TEST(TestDecodeOrdinals);
+	RUN_TEST(TestDocumentBitmap);
+	RUN_TEST(TestIdfCache);
+	RUN_TEST(TestRemapOrdinals);
+	RUN_TEST(TestPurgeRemovedPostings);
+	RUN_TEST(TestPurgeEmptyTerms);
+	RUN_TEST(TestRemovedPostings);
+	RUN_TEST(TestStringArena);
+}
@@ -0,0 +1,97 @@
+#include "test_process_queries.h"
+#include "process_queries.h"
+#include "test_engine.h"
+#include <string>
+#include <vector>
+
+using std::literals::string_literals::operator""s;
+
+namespace {
+
+SearchServer MakeServerForProcessQueries() {
+	SearchServer search_server("and with"s);
+	int id = 0;
+	for (
+		const std::string& text : {
+			"funny pet and nasty rat"s,
+			"funny pet with curly hair"s,
+			"funny pet and not very nasty rat"s,
+			"pet with rat and rat and rat"s,
+			"nasty rat with curly hair"s,
+		}
+	) {
+		search_server.AddDocument(++id, text, DocumentStatus::ACTUAL, {1, 2});
+	}
+	return search_server;
+}
+
+const std::vector<std::string> QUERIES_FOR_PROCESSING = {
+	"nasty rat -not"s,
+	"not very funny nasty pet"s,
+	"unknown"s,
+	"curly hair"s
+};
+
+std::vector<int> GetIds(const std::vector<Document> & documents) {
+	std::vector<int> ids;
+	for (const Document & document : documents) {
+		ids.push_back(document.id);
+	}
+	return ids;
+}
+
+} // namespace
+
+// Проверяет, что плоский результат разбит по запросам так же, как результат ProcessQueries
+void TestProcessQueriesFlat() {
+	ThreadPool thread_pool(2);
+	SearchServer search_server = MakeServerForProcessQueries();
+	search_server.SetThreadPool(thread_pool);
+	const auto expected = ProcessQueries(search_server, QUERIES_FOR_PROCESSING);
+
+	const FlatQueryResults results = ProcessQueriesFlat(search_server, QUERIES_FOR_PROCESSING);
+	ASSERT_EQUAL(results.GetQueryCount(), QUERIES_FOR_PROCESSING.size());
+	ASSERT_EQUAL(results.offsets.front(), 0u);
+	ASSERT_EQUAL(results.offsets.back(), results.documents.size());
+	for (size_t i = 0; i < expected.size(); ++i) {
+		const auto documents = results.GetDocuments(i);
+		ASSERT_EQUAL(documents.size(), expected[i].size());
+		ASSERT_EQUAL(GetIds({documents.begin(), documents.end()}), GetIds(expected[i]));
+	}
+	ASSERT(results.GetDocuments(2).begin() == results.GetDocuments(2).end());
+
+	std::vector<int> joined_ids;
+	for (const Document & document : ProcessQueriesJoined(search_server, QUERIES_FOR_PROCESSING)) {
+		joined_ids.push_back(document.id);
+	}
+	ASSERT_EQUAL(joined_ids, GetIds(results.documents));
+
+	const FlatQueryResults empty_results = ProcessQueriesFlat(search_server, {});
+	ASSERT_EQUAL(empty_results.GetQueryCount(), 0u);
+	ASSERT(empty_results.documents.empty());
+}
+
+// Проверяет, что callback вызывается по одному разу для каждого запроса
+void TestProcessQueriesStreaming() {
+	ThreadPool thread_pool(2);
+	SearchServer search_server = MakeServerForProcessQueries();
+	search_server.SetThreadPool(thread_pool);
+	const auto expected = ProcessQueries(search_server, QUERIES_FOR_PROCESSING);
+
+	std::vector<std::vector<Document>> received(QUERIES_FOR_PROCESSING.size());
+	std::vector<int> call_counts(QUERIES_FOR_PROCESSING.size());
+	ProcessQueriesStreaming(search_server, QUERIES_FOR_PROCESSING,
+		[&](size_t query_index, std::vector<Document> && documents) {
+			++call_counts[query_index];
+			received[query_index] = std::move(documents);
+		});
+	for (size_t i = 0; i < expected.size(); ++i) {
+		ASSERT_EQUAL(call_counts[i], 1);
+		ASSERT_EQUAL(GetIds(received[i]), GetIds(expected[i]));
+	}
+}
+
+void TestProcessQueries() {
+	RUN_TEST(TestProcessQueriesFlat);
+	RUN_TEST(TestProcessQueriesStreaming);
+}
@@ -2,6 +2,10 @@
 #include "test_engine.h"
 #include "search_server.h"
 #include "remove_duplicates.h"
+#include "query_generator.h"
+#include <algorithm>
+#include <set>
+#include <stdexcept>
 
 // Проверяем, что в случае отсутствия дубликатов функция ничего не делает
 void TestRemoveWithoutDuplicates() {
@@ -46,8 +50,166 @@ void TestRemoveOnlyWordSetDuplicates() {
 	ASSERT_EQUAL(*search_server.begin(), 1);
 }
 
+// Проверяем, что функции возвращают id дубликатов, а FindDuplicates не меняет сервер
+void TestReturnedDuplicates() {
+	SearchServer search_server("and with"s);
+	search_server.AddDocument(4, "funny pet and nasty rat"s, DocumentStatus::ACTUAL, {7, 2, 7});
+	search_server.AddDocument(2, "nasty rat and funny pet"s, DocumentStatus::ACTUAL, {7, 2, 7});
+	search_server.AddDocument(7, "curly hair"s, DocumentStatus::ACTUAL, {1});
+	search_server.AddDocument(9, "funny pet with nasty rat"s, DocumentStatus::BANNED, {1});
+	search_server.AddDocument(11, "hair curly curly"s, DocumentStatus::ACTUAL, {1});
+
+	const std::vector<int> expected = {4, 9, 11};
+	ASSERT(FindDuplicates(search_server) == expected);
+	ASSERT_EQUAL(search_server.GetDocumentCount(), 5);
+	ASSERT(RemoveDuplicates(search_server) == expected);
+	ASSERT_EQUAL(search_server.GetDocumentCount(), 2);
+	ASSERT(RemoveDuplicates(search_server).empty());
+}
+
+// Проверяем на большом наборе, который делится между потоками, совпадение
+// с поиском дубликатов по множеству наборов слов
+void TestDuplicatesMatchWordSets() {
+	std::mt19937 generator;
+	const auto dictionary = GenerateDictionary(generator, 12, 4);
+	const auto documents = GenerateQueries(generator, dictionary, 10'000, 4);
+	SearchServer search_server;
+	for (size_t i = 0; i < documents.size(); ++i) {
+		search_server.AddDocument(static_cast<int>(i), documents[i], DocumentStatus::ACTUAL, {1});
+	}
+
+	std::vector<int> expected;
+	std::set<std::vector<InvertedIndex::TermId>> scanned;
+	for (const int document_id : search_server) {
+		std::vector<InvertedIndex::TermId> document_words;
+		for (const auto& [term_id, tf] : search_server.GetDocumentTerms(document_id)) {
+			document_words.push_back(term_id);
+		}
+		if (!scanned.insert(document_words).second) {
+			expected.push_back(document_id);
+		}
+	}
+	ASSERT(!expected.empty());
+	ASSERT(RemoveDuplicates(search_server) == expected);
+	ASSERT_EQUAL(search_server.GetDocumentCount(), static_cast<int>(scanned.size()));
+}
+
+// Проверяем, что находятся документы, отличающиеся одним словом, а почти дубликат
+// удаленного документа остается
+void TestRemoveNearDuplicates() {
+	SearchServer search_server;
+	search_server.AddDocument(1, "a b c d e f g h i j"s, DocumentStatus::ACTUAL, {1});
+	// Одно слово заменено: мера Жаккара 9 / 11
+	search_server.AddDocument(2, "a b c d e f g h i k"s, DocumentStatus::ACTUAL, {1});
+	// Похож на 2, но с 1 совпадает только 8 слов из 12
+	search_server.AddDocument(3, "a b c d e f g h k l"s, DocumentStatus::ACTUAL, {1});
+	search_server.AddDocument(4, "j i h g f e d c b a"s, DocumentStatus::ACTUAL, {1});
+	search_server.AddDocument(5, "a b c d e u v w x y"s, DocumentStatus::ACTUAL, {1});
+	search_server.AddDocument(6, ""s, DocumentStatus::ACTUAL, {1});
+
+	const std::vector<int> expected = {2, 4};
+	ASSERT(FindNearDuplicates(search_server) == expected);
+	ASSERT_EQUAL(search_server.GetDocumentCount(), 6);
+
+	NearDuplicateOptions options;
+	options.jaccard_threshold = 1.0;
+	ASSERT(FindNearDuplicates(search_server, options) == std::vector<int>{4});
+
+	ASSERT(RemoveNearDuplicates(search_server) == expected);
+	ASSERT_EQUAL(search_server.GetDocumentCount(), 4);
+	ASSERT(FindNearDuplicates(search_server).empty());
+}
+
+// Проверяем исключения при недопустимых параметрах
+void TestNearDuplicateOptions() {
+	SearchServer search_server;
+	search_server.AddDocument(1, "funny pet"s, DocumentStatus::ACTUAL, {1});
+	for (const auto& [threshold, band_count, rows_per_band] : std::vector<std::tuple<double, size_t, size_t>>{
+		{0.0, 16, 8}, {1.5, 16, 8}, {0.8, 0, 8}, {0.8, 16, 0}})
+	{
+		NearDuplicateOptions options;
+		options.jaccard_threshold = threshold;
+		options.band_count = band_count;
+		options.rows_per_band = rows_per_band;
+		bool has_invalid_argument_exception = false;
+		try {
+			FindNearDuplicates(search_server, options);
+		} catch (const std::invalid_argument& exception) {
+			has_invalid_argument_exception = true;
+		} catch (...) {
+		}
+		ASSERT(has_invalid_argument_exception);
+	}
+}
+
+// Проверяем на большом наборе, который делится между потоками, что находятся все копии
+// документов и только они. Копии отличаются одним словом из 20, для них LSH почти
+// наверняка дает кандидата, а случайные документы из большого словаря не похожи
+void TestNearDuplicatesOfCopies() {
+	std::mt19937 generator;
+	const auto dictionary = GenerateDictionary(generator, 3'000, 8);
+	SearchServer search_server;
+	for (int i = 0; i < 1'500; ++i) {
+		std::vector<std::string> words;
+		while (words.size() < 20) {
+			const std::string& word = dictionary[generator() % dictionary.size()];
+			if (std::find(words.begin(), words.end(), word) == words.end()) {
+				words.push_back(word);
+			}
+		}
+		std::string text;
+		for (const std::string& word : words) {
+			text += word + " "s;
+		}
+		search_server.AddDocument(2 * i, text, DocumentStatus::ACTUAL, {1});
+		if (i % 2 == 0) {
+			search_server.AddDocument(2 * i + 1, text + "copy"s, DocumentStatus::ACTUAL, {1});
+		} else {
+			words[i % words.size()] = "copy"s;
+			text.clear();
+			for (const std::string& word : words) {
+				text += word + " "s;
+			}
+			search_server.AddDocument(2 * i + 1, text, DocumentStatus::ACTUAL, {1});
+		}
+	}
+
+	const auto jaccard = [&](int lhs_id, int rhs_id) {
+		std::set<InvertedIndex::TermId> lhs;
+		std::set<InvertedIndex::TermId> rhs;
+		for (const auto& [term_id, tf] : search_server.GetDocumentTerms(lhs_id)) {
+			lhs.insert(term_id);
+		}
+		size_t common = 0;
+		for (const auto& [term_id, tf] : search_server.GetDocumentTerms(rhs_id)) {
+			rhs.insert(term_id);
+			common += lhs.count(term_id);
+		}
+		return static_cast<double>(common) / static_cast<double>(lhs.size() + rhs.size() - common);
+	};
+	std::vector<int> expected;
+	std::vector<int> kept;
+	for (const int document_id : search_server) {
+		const int original_id = document_id / 2 * 2;
+		if (original_id != document_id && std::count(kept.begin(), kept.end(), original_id)
+			&& jaccard(original_id, document_id) >= 0.8)
+		{
+			expected.push_back(document_id);
+		} else {
+			kept.push_back(document_id);
+		}
+	}
+	ASSERT_EQUAL(expected.size(), 1'500u);
+	ASSERT(FindNearDuplicates(search_server) == expected);
+}
+
 void TestRemoveDuplicates() {
 	RUN_TEST(TestRemoveWithoutDuplicates);
 	RUN_TEST(TestRemoveFullDuplicates);
 	RUN_TEST(TestRemoveOnlyWordSetDuplicates);
+	RUN_TEST(TestReturnedDuplicates);
+	RUN_TEST(TestDuplicatesMatchWordSets);
+	RUN_TEST(TestRemoveNearDuplicates);
+	RUN_TEST(TestNearDuplicateOptions);
+	RUN_TEST(TestNearDuplicatesOfCopies);
 }
@@ -1,8 +1,15 @@
 #include "test_engine.h"
+#include "test_allocation_counter.h"
 #include "search_server.h"
+#include "query_generator.h"
+#include <atomic>
+#include <thread>
 #include <string>
 #include <vector>
 #include <cmath>
+#include <limits>
+#include <filesystem>
+#include <fstream>
 
 template <typename ExecutionPolicy>
 std::string PolicyToString([[maybe_unused]]const ExecutionPolicy & policy) {
@@ -13,6 +20,29 @@ std::string PolicyToString([[maybe_unused]]const ExecutionPolicy & policy) {
 	}
 }
 
+// Сравнивает два результата поиска поэлементно
+void AssertEqualDocuments(const std::vector<Document> & lhs, const std::vector<Document> & rhs,
+	const std::string & hint)
+{
+	ASSERT_EQUAL_HINT(lhs.size(), rhs.size(), hint);
+	for (size_t i = 0; i < lhs.size(); ++i) {
+		ASSERT_EQUAL_HINT(lhs.at(i).id, rhs.at(i).id, hint);
+		ASSERT_EQUAL_HINT(lhs.at(i).relevance, rhs.at(i).relevance, hint);
+		ASSERT_EQUAL_HINT(lhs.at(i).rating, rhs.at(i).rating, hint);
+	}
+}
+
+// Заполняет сервер случайными документами с разными рейтингами и статусами
+void AddRandomDocuments(SearchServer & search_server, std::mt19937 & generator,
+	const std::vector<std::string> & dictionary, int document_count, int max_word_count)
+{
+	const auto documents = GenerateQueries(generator, dictionary, document_count, max_word_count);
+	for (int id = 0; id < document_count; ++id) {
+		const DocumentStatus status = id % 5 == 0 ? DocumentStatus::BANNED : DocumentStatus::ACTUAL;
+		search_server.AddDocument(id, documents[id], status, {id % 7, id % 3});
+	}
+}
+
 // Тест проверяет, что поисковая система исключает стоп-слова при добавлении документов
 void TestExcludeStopWordsFromAddedDocumentContent() {
 	const int doc_id = 42;
@@ -368,6 +398,83 @@ void TestWordsTfInDocument() {
 	ASSERT_EQUAL(search_server.GetWordFrequencies(2), words_tf_empty);
 }
 
+// Словарь частот выдается по ссылке, живет до удаления документа и строится заново
+// для документа, добавленного под тем же id
+void TestWordFrequenciesReference() {
+	SearchServer search_server;
+	search_server.AddDocument(1, "big dog"s, DocumentStatus::ACTUAL, {1});
+	search_server.AddDocument(2, "cat"s, DocumentStatus::ACTUAL, {1});
+
+	const std::map<std::string_view, double> & words = search_server.GetWordFrequencies(1);
+	ASSERT_EQUAL(&words, &search_server.GetWordFrequencies(1));
+	ASSERT_EQUAL(words.size(), 2u);
+
+	// Копия сервера строит свои словари
+	const SearchServer copied_server = search_server;
+	ASSERT(&copied_server.GetWordFrequencies(1) != &words);
+	ASSERT_EQUAL(copied_server.GetWordFrequencies(1), words);
+
+	search_server.RemoveDocument(1);
+	ASSERT(search_server.GetWordFrequencies(1).empty());
+	search_server.AddDocument(1, "cat"s, DocumentStatus::ACTUAL, {1});
+	ASSERT_EQUAL(search_server.GetWordFrequencies(1).size(), 1u);
+	ASSERT_EQUAL(search_server.GetWordFrequencies(1).count("cat"), 1u);
+
+	search_server.GetWordFrequencies(2);
+	search_server.RemoveDocuments({1, 2});
+	ASSERT(search_server.GetWordFrequencies(2).empty());
+	search_server.AddDocument(2, "big dog"s, DocumentStatus::ACTUAL, {1});
+	ASSERT_EQUAL(search_server.GetWordFrequencies(2).count("big"), 1u);
+
+	// Буфер потока хранит словари ограниченного числа документов: вытесненный словарь
+	// строится заново, а словари сервера, прочитанные из нескольких потоков, совпадают
+	constexpr int DOCUMENT_COUNT = 3 * SearchServer::WORD_FREQUENCY_CACHE_SIZE;
+	for (int id = 10; id < 10 + DOCUMENT_COUNT; ++id) {
+		search_server.AddDocument(id, "word"s + std::to_string(id) + " common"s, DocumentStatus::ACTUAL, {1});
+	}
+	std::atomic<int> failures = 0;
+	const auto read_words = [&search_server, &failures] {
+		for (int round = 0; round < 3; ++round) {
+			for (int id = 10; id < 10 + DOCUMENT_COUNT; ++id) {
+				const auto & words = search_server.GetWordFrequencies(id);
+				if (words.size() != 2u || words.count("word"s + std::to_string(id)) != 1u) {
+					++failures;
+				}
+			}
+		}
+	};
+	std::thread reader(read_words);
+	read_words();
+	reader.join();
+	ASSERT_EQUAL(failures.load(), 0);
+}
+
+// Прямой индекс документа: пары (id слова, tf) по возрастанию id без повторов
+void TestDocumentTerms() {
+	SearchServer search_server;
+	search_server.AddDocument(1, "big dog big eyes"s, DocumentStatus::ACTUAL, {7, 2, 7});
+	search_server.AddDocument(2, "eyes of a cat"s, DocumentStatus::ACTUAL, {1});
+	search_server.AddDocuments({{3, "cat eyes big", DocumentStatus::ACTUAL, {1}}});
+
+	for (int document_id : search_server) {
+		const auto & terms = search_server.GetDocumentTerms(document_id);
+		std::map<std::string_view, double> words_tf;
+		for (size_t i = 0; i < terms.size(); ++i) {
+			ASSERT(i == 0 || terms[i - 1].term_id < terms[i].term_id);
+			words_tf[search_server.GetTerm(terms[i].term_id)] = terms[i].tf;
+		}
+		ASSERT_EQUAL(words_tf, search_server.GetWordFrequencies(document_id));
+	}
+	ASSERT_EQUAL(search_server.GetDocumentTerms(1).size(), 3u);
+	ASSERT(search_server.GetDocumentTerms(4).empty());
+
+	// Слово, общее для документов, получает один id
+	const auto & first_terms = search_server.GetDocumentTerms(1);
+	const auto & third_terms = search_server.GetDocumentTerms(3);
+	ASSERT_EQUAL(first_terms.front().term_id, third_terms.front().term_id);
+	ASSERT_EQUAL(search_server.GetTerm(first_terms.front().term_id), "big"s);
+}
+
 // Тест проверяет исключения в конструкторе
 void TestCreateSearchServer() {
 	// Проверяем исключение при создании сервера без стоп-слов
@@ -436,7 +543,7 @@ void TestCreateSearchServer() {
 
 	//Проверяем создание из string_view
 	{
-		std::string_view stop_words {"dog"s};
+		std::string_view stop_words {"dog"};
 		bool has_exception_without_special_char_in_string = false;
 		try {
 			SearchServer search_server(stop_words);
@@ -636,6 +743,927 @@ void TestRemoveDocument() {
 	TestRemoveDocumentPolicy(std::execution::par);
 }
 
+// Тест проверяет, что пакетное удаление дает тот же сервер, что и удаление по одному
+void TestRemoveDocuments() {
+	std::mt19937 generator;
+	const auto dictionary = GenerateDictionary(generator, 200, 6);
+	SearchServer search_server;
+	AddRandomDocuments(search_server, generator, dictionary, 3'000, 10);
+	SearchServer expected_server = search_server;
+
+	SearchOptions options;
+	options.top_k = 3'000;
+	const auto check = [&](const std::string & hint) {
+		ASSERT_EQUAL_HINT(search_server.GetDocumentCount(), expected_server.GetDocumentCount(), hint);
+		for (size_t i = 0; i < 20; ++i) {
+			const std::string & query = dictionary[i];
+			const auto result = search_server.FindTopDocuments(query, DocumentStatus::ACTUAL, options);
+			const auto expected = expected_server.FindTopDocuments(query, DocumentStatus::ACTUAL, options);
+			ASSERT_EQUAL_HINT(result.size(), expected.size(), hint);
+			for (size_t j = 0; j < result.size(); ++j) {
+				ASSERT_EQUAL_HINT(result[j].id, expected[j].id, hint);
+				ASSERT_HINT(std::abs(result[j].relevance - expected[j].relevance) < 1e-9, hint);
+			}
+		}
+	};
+
+	// Повторы и неизвестные id пропускаются
+	std::vector<int> document_ids = {5, 5, 100'000, -1};
+	for (int id = 0; id < 3'000; id += 3) {
+		document_ids.push_back(id);
+	}
+	search_server.RemoveDocuments(document_ids);
+	for (int id = 0; id < 3'000; id += 3) {
+		expected_server.RemoveDocument(id);
+	}
+	expected_server.RemoveDocument(5);
+	check("without compaction"s);
+	ASSERT(search_server.FindTopDocuments(dictionary[0], [](int document_id, DocumentStatus, int) {
+		return document_id % 3 == 0;
+	}).empty());
+
+	// Удаленных документов становится больше, чем живых
+	document_ids.clear();
+	for (int id = 1; id < 3'000; id += 3) {
+		document_ids.push_back(id);
+		expected_server.RemoveDocument(id);
+	}
+	search_server.RemoveDocuments(document_ids);
+	check("with compaction"s);
+
+	search_server.RemoveDocuments({});
+	check("empty batch"s);
+}
+
+// Тест проверяет поиск после перенумерации документов, запускаемой массовым удалением
+void TestSearchAfterOrdinalCompaction() {
+	SearchServer search_server;
+	for (int id = 0; id < 100; ++id) {
+		search_server.AddDocument(id, id % 2 == 0 ? "cat"s : "dog"s, DocumentStatus::ACTUAL, {id});
+	}
+	// Удаляем больше половины документов. Удаление само индекс не сжимает
+	for (int id = 0; id < 80; ++id) {
+		search_server.RemoveDocument(id);
+	}
+	ASSERT(search_server.NeedsCompaction());
+	search_server.Compact();
+	ASSERT(!search_server.NeedsCompaction());
+	search_server.AddDocument(1000, "cat dog"s, DocumentStatus::ACTUAL, {1});
+
+	auto result = search_server.FindTopDocuments("cat"s);
+	ASSERT_EQUAL(result.size(), 5u);
+	ASSERT_EQUAL(result.at(0).id, 98);
+	SearchOptions options;
+	options.top_k = 100;
+	ASSERT_EQUAL(search_server.FindTopDocuments("cat"s, DocumentStatus::ACTUAL, options).size(), 11u);
+	ASSERT_EQUAL(search_server.FindTopDocuments(std::execution::par, "dog -cat"s,
+		DocumentStatus::ACTUAL, options).size(), 10u);
+
+	const auto [words, status] = search_server.MatchDocument("cat dog"s, 1000);
+	ASSERT_EQUAL(words.size(), 2u);
+	ASSERT(std::get<0>(search_server.MatchDocument("cat"s, 99)).empty());
+}
+
+// Тест проверяет, что удаленные, но еще не выброшенные из индекса документы
+// не находятся и не влияют на релевантность, а сжатие не меняет результатов
+void TestSearchBeforeCompaction() {
+	SearchServer search_server;
+	SearchServer expected_server;
+	for (int id = 0; id < 10; ++id) {
+		const std::string text = id % 3 == 0 ? "cat dog"s : "cat bird"s;
+		search_server.AddDocument(id, text, DocumentStatus::ACTUAL, {id});
+		if (id >= 3) {
+			expected_server.AddDocument(id, text, DocumentStatus::ACTUAL, {id});
+		}
+	}
+	// Удаленных документов меньше, чем живых, поэтому сжатие пока не нужно
+	for (int id = 0; id < 3; ++id) {
+		search_server.RemoveDocument(id);
+	}
+
+	SearchOptions options;
+	options.top_k = 100;
+	const auto check = [&](const SearchServer & server, const std::string & hint) {
+		for (const std::string & query : {"cat"s, "dog"s, "bird -dog"s, "cat dog"s}) {
+			const auto result = server.FindTopDocuments(query, DocumentStatus::ACTUAL, options);
+			const auto expected = expected_server.FindTopDocuments(query, DocumentStatus::ACTUAL, options);
+			ASSERT_EQUAL_HINT(result.size(), expected.size(), hint);
+			for (size_t i = 0; i < result.size(); ++i) {
+				ASSERT_EQUAL_HINT(result[i].id, expected[i].id, hint);
+				ASSERT_HINT(std::abs(result[i].relevance - expected[i].relevance) < 1e-9, hint);
+			}
+			// Поиск без фильтра по статусу тоже не видит удаленных документов
+			const auto by_predicate = server.FindTopDocuments(query,
+				[](int, DocumentStatus, int) { return true; }, options);
+			ASSERT_EQUAL_HINT(by_predicate.size(), expected.size(), hint);
+		}
+		// Слово, оставшееся только в удаленных документах, ничего не находит
+		ASSERT_HINT(server.FindTopDocuments("dog -cat"s).empty(), hint);
+	};
+	check(search_server, "before compaction"s);
+
+	// В снимок попадают только живые документы
+	const std::string path = (std::filesystem::temp_directory_path() / "search_server_removed.snapshot").string();
+	search_server.SaveSnapshot(path);
+	check(SearchServer::LoadSnapshot(path), "snapshot"s);
+	std::filesystem::remove(path);
+
+	search_server.Compact();
+	ASSERT_EQUAL(search_server.GetDocumentCount(), 7);
+	check(search_server, "after compaction"s);
+}
+
+// Тест проверяет поиск по спискам, очищенным от удаленных вхождений без перенумерации,
+// и сжатие без удаленных документов
+void TestSearchAfterPostingsPurge() {
+	SearchServer search_server;
+	SearchServer expected_server;
+	for (int id = 0; id < 20; ++id) {
+		const std::string text = id < 4 ? "cat bird"s : id < 8 ? "cat fox"s : "cat dog"s;
+		search_server.AddDocument(id, text, DocumentStatus::ACTUAL, {id});
+		if (id % 4 == 3 || id >= 8) {
+			expected_server.AddDocument(id, text, DocumentStatus::ACTUAL, {id});
+		}
+	}
+	// Из списков bird и fox удалено больше половины вхождений по одному документу и пакетом,
+	// а документов удалено меньше половины
+	for (const int id : {0, 1, 2}) {
+		search_server.RemoveDocument(id);
+	}
+	search_server.RemoveDocuments({4, 5, 6});
+
+	SearchOptions options;
+	options.top_k = 100;
+	const auto check = [&](const std::string & hint) {
+		for (const std::string & query : {"bird"s, "fox"s, "cat"s, "cat -bird"s, "bird fox dog"s}) {
+			const auto result = search_server.FindTopDocuments(query, DocumentStatus::ACTUAL, options);
+			const auto expected = expected_server.FindTopDocuments(query, DocumentStatus::ACTUAL, options);
+			ASSERT_EQUAL_HINT(result.size(), expected.size(), hint);
+			for (size_t i = 0; i < result.size(); ++i) {
+				ASSERT_EQUAL_HINT(result[i].id, expected[i].id, hint);
+				ASSERT_HINT(std::abs(result[i].relevance - expected[i].relevance) < 1e-9, hint);
+			}
+		}
+	};
+	check("after purge"s);
+
+	search_server.Compact();
+	check("after compaction"s);
+	search_server.Compact();
+	check("repeated compaction"s);
+}
+
+// Тест проверяет, что при сжатии из словаря выбрасываются слова удаленных документов,
+// а словари GetWordFrequencies строятся по перестроенному словарю
+void TestTermPurgeOnCompaction() {
+	SearchServer search_server;
+	search_server.AddDocument(1000, "common keep"s, DocumentStatus::ACTUAL, {1});
+	ASSERT_EQUAL(search_server.GetWordFrequencies(1000).size(), 2u);
+	constexpr int ROUND_SIZE = 10;
+	for (int round = 0; round < 10; ++round) {
+		for (int i = 0; i < ROUND_SIZE; ++i) {
+			search_server.AddDocument(round * ROUND_SIZE + i,
+				"common word"s + std::to_string(round * ROUND_SIZE + i), DocumentStatus::ACTUAL, {1});
+		}
+		if (round > 0) {
+			std::vector<int> removed_ids;
+			for (int i = 0; i < ROUND_SIZE; ++i) {
+				removed_ids.push_back((round - 1) * ROUND_SIZE + i);
+			}
+			search_server.RemoveDocuments(removed_ids);
+			search_server.Compact();
+		}
+		// Без очистки словарь рос бы на ROUND_SIZE слов за раунд
+		ASSERT_HINT(search_server.GetTermCount() <= 4 * ROUND_SIZE, std::to_string(round));
+	}
+	const auto found = search_server.FindTopDocuments("word95 word5"s);
+	ASSERT_EQUAL(found.size(), 1u);
+	ASSERT_EQUAL(found[0].id, 95);
+
+	for (int id = 9 * ROUND_SIZE; id < 10 * ROUND_SIZE; ++id) {
+		search_server.RemoveDocument(id);
+	}
+	search_server.Compact();
+	ASSERT_EQUAL(search_server.GetTermCount(), 2u);
+
+	// Ключи словаря указывают на строки перестроенного словаря индекса
+	const std::map<std::string_view, double> & frequencies = search_server.GetWordFrequencies(1000);
+	ASSERT_EQUAL(frequencies.size(), 2u);
+	ASSERT_EQUAL(frequencies.at("keep"s), 0.5);
+	ASSERT_EQUAL(frequencies.at("common"s), 0.5);
+	for (const InvertedIndex::TermFrequency & term : search_server.GetDocumentTerms(1000)) {
+		const std::string_view word = search_server.GetTerm(term.term_id);
+		ASSERT_EQUAL(frequencies.find(word)->first.data(), word.data());
+	}
+
+	const auto [words, status] = search_server.MatchDocument("keep word95 word5"s, 1000);
+	ASSERT_EQUAL(words.size(), 1u);
+	ASSERT_EQUAL(words[0], "keep"s);
+	ASSERT(search_server.FindTopDocuments("word95"s).empty());
+	ASSERT_EQUAL(search_server.FindTopDocuments("keep"s).size(), 1u);
+	search_server.AddDocument(95, "word95"s, DocumentStatus::ACTUAL, {1});
+	ASSERT_EQUAL(search_server.FindTopDocuments("word95"s).size(), 1u);
+}
+
+// Тест проверяет, что удаление документов не выбрасывает слова из словаря,
+// поэтому строки результата MatchDocument живого документа остаются действительными
+void TestMatchedWordsSurviveRemoval() {
+	SearchServer search_server;
+	for (int id = 0; id < 10; ++id) {
+		search_server.AddDocument(id, "w"s + std::to_string(id) + " common"s, DocumentStatus::ACTUAL, {1});
+	}
+	const auto [words, status] = search_server.MatchDocument("w9 common"s, 9);
+	// Удаленных документов становится больше, чем живых, но удаление индекс не сжимает
+	for (int id = 0; id < 7; ++id) {
+		search_server.RemoveDocument(id);
+	}
+	ASSERT(search_server.NeedsCompaction());
+	const std::vector<std::string> expected = {"common"s, "w9"s};
+	ASSERT_EQUAL(std::vector<std::string>(words.begin(), words.end()), expected);
+	ASSERT_EQUAL(search_server.GetTermCount(), 11u);
+}
+
+// Тест проверяет выдачу заданного количества лучших документов
+template <typename ExecutionPolicy>
+void TestTopKInFindTopDocumentsPolicy(const ExecutionPolicy & policy) {
+	std::string policy_str = PolicyToString(policy);
+
+	// Документов больше, чем порог параллельного отбора
+	SearchServer search_server;
+	const int document_count = 10'000;
+	for (int id = 0; id < document_count; ++id) {
+		const std::string text = id % 7 == 0 ? "cat cat dog"s : "cat dog bird"s;
+		search_server.AddDocument(id, text, DocumentStatus::ACTUAL, {id % 13});
+	}
+
+	SearchOptions options;
+	options.top_k = 20;
+	const auto top = search_server.FindTopDocuments(policy, "cat"s, DocumentStatus::ACTUAL, options);
+	ASSERT_EQUAL_HINT(top.size(), 20u, policy_str);
+
+	// Результат совпадает с полной сортировкой всех найденных документов
+	options.top_k = document_count;
+	auto all = search_server.FindTopDocuments(policy, "cat"s, DocumentStatus::ACTUAL, options);
+	ASSERT_EQUAL_HINT(all.size(), static_cast<size_t>(document_count), policy_str);
+	std::sort(all.begin(), all.end(), IsMoreRelevant);
+	for (size_t i = 0; i < top.size(); ++i) {
+		ASSERT_EQUAL_HINT(top.at(i).id, all.at(i).id, policy_str);
+	}
+
+	// По умолчанию возвращается MAX_RESULT_DOCUMENT_COUNT документов
+	ASSERT_EQUAL_HINT(search_server.FindTopDocuments(policy, "cat"s).size(),
+		static_cast<size_t>(MAX_RESULT_DOCUMENT_COUNT), policy_str);
+
+	// Неограниченный top_k не выделяет память заранее под все места
+	options.top_k = std::numeric_limits<size_t>::max();
+	for (const ScoringStrategy strategy : {ScoringStrategy::EXHAUSTIVE, ScoringStrategy::MAX_SCORE}) {
+		options.strategy = strategy;
+		ASSERT_EQUAL_HINT(search_server.FindTopDocuments(policy, "cat"s, DocumentStatus::ACTUAL, options).size(),
+			static_cast<size_t>(document_count), policy_str);
+	}
+	options.strategy = ScoringStrategy::EXHAUSTIVE;
+
+	options.top_k = 0;
+	ASSERT_HINT(search_server.FindTopDocuments(policy, "cat"s, DocumentStatus::ACTUAL, options).empty(),
+		policy_str);
+}
+
+void TestTopKInFindTopDocuments() {
+	TestTopKInFindTopDocumentsPolicy(std::execution::seq);
+	TestTopKInFindTopDocumentsPolicy(std::execution::par);
+}
+
+// Тест проверяет, что отсечение MaxScore возвращает то же, что и полный перебор
+template <typename ExecutionPolicy>
+void TestMaxScoreMatchesExhaustivePolicy(const ExecutionPolicy & policy) {
+	std::string policy_str = PolicyToString(policy);
+
+	std::mt19937 generator;
+	const auto dictionary = GenerateDictionary(generator, 300, 6);
+	SearchServer search_server(dictionary[0]);
+	AddRandomDocuments(search_server, generator, dictionary, 3'000, 20);
+	for (int id = 0; id < 3'000; id += 11) {
+		search_server.RemoveDocument(id);
+	}
+
+	SearchOptions exhaustive;
+	SearchOptions pruned;
+	pruned.strategy = ScoringStrategy::MAX_SCORE;
+	for (size_t top_k : {1u, 5u, 30u}) {
+		exhaustive.top_k = top_k;
+		pruned.top_k = top_k;
+		for (int i = 0; i < 50; ++i) {
+			const std::string query = GenerateQueryStrict(generator, dictionary, 1 + i % 12, 0.1);
+			AssertEqualDocuments(
+				search_server.FindTopDocuments(policy, query, DocumentStatus::ACTUAL, exhaustive),
+				search_server.FindTopDocuments(policy, query, DocumentStatus::ACTUAL, pruned),
+				policy_str + " query: "s + query);
+			const auto even_ids = [](int document_id, DocumentStatus, int) {
+				return document_id % 2 == 0;
+			};
+			AssertEqualDocuments(
+				search_server.FindTopDocuments(policy, query, even_ids, exhaustive),
+				search_server.FindTopDocuments(policy, query, even_ids, pruned),
+				policy_str + " query: "s + query);
+		}
+	}
+}
+
+// На документах одной длины границы вкладов слов точные, поэтому отсечение срабатывает часто,
+// а у кандидатов находятся и несущественные слова
+template <typename ExecutionPolicy>
+void TestMaxScoreOnUniformDocumentsPolicy(const ExecutionPolicy & policy) {
+	std::string policy_str = PolicyToString(policy);
+
+	std::mt19937 generator;
+	const auto dictionary = GenerateDictionary(generator, 500, 8);
+	const auto texts = GenerateQueriesStrict(generator, dictionary, 5'000, 30);
+	SearchServer search_server;
+	for (int id = 0; id < 5'000; ++id) {
+		search_server.AddDocument(id, texts[id], DocumentStatus::ACTUAL, {id % 9});
+	}
+
+	SearchOptions exhaustive;
+	SearchOptions pruned;
+	pruned.strategy = ScoringStrategy::MAX_SCORE;
+	for (size_t top_k : {1u, 10u, 100u}) {
+		exhaustive.top_k = top_k;
+		pruned.top_k = top_k;
+		for (int i = 0; i < 20; ++i) {
+			const std::string query = GenerateQueryStrict(generator, dictionary, 5 + i, 0.05);
+			AssertEqualDocuments(
+				search_server.FindTopDocuments(policy, query, DocumentStatus::ACTUAL, exhaustive),
+				search_server.FindTopDocuments(policy, query, DocumentStatus::ACTUAL, pruned),
+				policy_str + " query: "s + query);
+		}
+	}
+}
+
+void TestMaxScoreMatchesExhaustive() {
+	TestMaxScoreMatchesExhaustivePolicy(std::execution::seq);
+	TestMaxScoreMatchesExhaustivePolicy(std::execution::par);
+	TestMaxScoreOnUniformDocumentsPolicy(std::execution::seq);
+	TestMaxScoreOnUniformDocumentsPolicy(std::execution::par);
+}
+
+void TestPartitionedParallelSearch() {
+	std::mt19937 generator;
+	const auto dictionary = GenerateDictionary(generator, 300, 6);
+	SearchServer search_server(dictionary[0]);
+	AddRandomDocuments(search_server, generator, dictionary, 2'000, 20);
+	for (int id = 0; id < 2'000; id += 7) {
+		search_server.RemoveDocument(id);
+	}
+
+	for (ScoringStrategy strategy : {ScoringStrategy::EXHAUSTIVE, ScoringStrategy::MAX_SCORE}) {
+		SearchOptions options;
+		options.strategy = strategy;
+		options.top_k = 10;
+		for (int i = 0; i < 20; ++i) {
+			const std::string query = GenerateQueryStrict(generator, dictionary, 1 + i % 8, 0.2);
+			const auto expected = search_server.FindTopDocuments(std::execution::seq,
+				query, DocumentStatus::ACTUAL, options);
+			// Частей больше, чем документов, тоже допустимо - лишние части пусты
+			for (size_t partition_count : {1u, 2u, 3u, 7u, 5'000u}) {
+				options.partition_count = partition_count;
+				AssertEqualDocuments(expected,
+					search_server.FindTopDocuments(std::execution::par, query, DocumentStatus::ACTUAL, options),
+					"partitions: "s + std::to_string(partition_count) + " query: "s + query);
+			}
+			options.partition_count = 0;
+		}
+	}
+}
+
+// Проверяет, что многопоточный поиск с потокобезопасным предикатом, который вызывается
+// из потоков пула одновременно, находит то же, что последовательный
+void TestParallelSearchWithFilter() {
+	ThreadPool thread_pool(3);
+	std::mt19937 generator;
+	const auto dictionary = GenerateDictionary(generator, 300, 6);
+	SearchServer search_server(dictionary[0]);
+	search_server.SetThreadPool(thread_pool);
+	AddRandomDocuments(search_server, generator, dictionary, 2'000, 20);
+
+	std::atomic<int> call_count = 0;
+	const auto filter = [&call_count](int document_id, DocumentStatus status, int rating) {
+		++call_count;
+		return document_id % 3 != 0 && status != DocumentStatus::BANNED && rating >= 0;
+	};
+	for (ScoringStrategy strategy : {ScoringStrategy::EXHAUSTIVE, ScoringStrategy::MAX_SCORE}) {
+		SearchOptions options;
+		options.strategy = strategy;
+		options.partition_count = 4;
+		for (int i = 0; i < 20; ++i) {
+			const std::string query = GenerateQueryStrict(generator, dictionary, 1 + i % 8, 0.2);
+			const auto expected = search_server.FindTopDocuments(std::execution::seq, query, filter, options);
+			call_count = 0;
+			AssertEqualDocuments(expected, search_server.FindTopDocuments(std::execution::par, query, filter, options),
+				"query: "s + query);
+			ASSERT_HINT(call_count > 0 || expected.empty(), query);
+		}
+	}
+}
+
+// Проверяет исключение по частому минус-слову, список которого длиннее кандидатов
+// и проверяется пропусками, и по редкому, список которого обходится целиком
+template <typename ExecutionPolicy>
+void TestFrequentMinusWordsPolicy(const ExecutionPolicy & policy) {
+	std::string policy_str = PolicyToString(policy);
+
+	SearchServer search_server(""s);
+	for (int id = 0; id < 2'000; ++id) {
+		std::string text = "cat"s;
+		if (id % 50 != 0) {
+			text += " common"s;
+		}
+		if (id % 10 == 0) {
+			text += " rare"s;
+		}
+		search_server.AddDocument(id, text, DocumentStatus::ACTUAL, {id % 7});
+	}
+
+	for (ScoringStrategy strategy : {ScoringStrategy::EXHAUSTIVE, ScoringStrategy::MAX_SCORE}) {
+		SearchOptions options;
+		options.strategy = strategy;
+		options.top_k = 1'000;
+		const std::string hint = policy_str + " strategy: "s + std::to_string(static_cast<int>(strategy));
+
+		const auto rare_only = search_server.FindTopDocuments(policy, "rare -common"s,
+			DocumentStatus::ACTUAL, options);
+		ASSERT_EQUAL_HINT(rare_only.size(), 40u, hint);
+		for (const Document & document : rare_only) {
+			ASSERT_EQUAL_HINT(document.id % 50, 0, hint);
+		}
+
+		const auto common_only = search_server.FindTopDocuments(policy, "common -rare"s,
+			DocumentStatus::ACTUAL, options);
+		ASSERT_EQUAL_HINT(common_only.size(), 1'000u, hint);
+		for (const Document & document : common_only) {
+			ASSERT_HINT(document.id % 10 != 0, hint);
+		}
+	}
+}
+
+void TestFrequentMinusWords() {
+	TestFrequentMinusWordsPolicy(std::execution::seq);
+	TestFrequentMinusWordsPolicy(std::execution::par);
+}
+
+// Проверяет фильтрацию по статусу и именованным множествам документов
+template <typename ExecutionPolicy>
+void TestDocumentSetsPolicy(const ExecutionPolicy & policy) {
+	std::string policy_str = PolicyToString(policy);
+
+	SearchServer search_server(""s);
+	for (int id = 0; id < 300; ++id) {
+		const DocumentStatus status = id % 3 == 0 ? DocumentStatus::BANNED : DocumentStatus::ACTUAL;
+		search_server.AddDocument(id, "cat in the city"s, status, {id});
+	}
+	std::vector<int> tenant;
+	for (int id = 0; id < 300; id += 2) {
+		tenant.push_back(id);
+	}
+	search_server.SetDocumentSet("tenant"s, tenant);
+	search_server.SetDocumentSet("first_half"s, {0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 150});
+
+	for (ScoringStrategy strategy : {ScoringStrategy::EXHAUSTIVE, ScoringStrategy::MAX_SCORE}) {
+		SearchOptions options;
+		options.strategy = strategy;
+		options.top_k = 1'000;
+		options.document_sets = {"tenant"s};
+		const auto tenant_docs = search_server.FindTopDocuments(policy, "cat"s, DocumentStatus::ACTUAL, options);
+		ASSERT_EQUAL_HINT(tenant_docs.size(), 100u, policy_str);
+		for (const Document & document : tenant_docs) {
+			ASSERT_HINT(document.id % 2 == 0 && document.id % 3 != 0, policy_str);
+		}
+
+		// Множество сочетается с произвольным фильтром
+		const auto high_rated = search_server.FindTopDocuments(policy, "cat"s,
+			[](int, DocumentStatus, int rating) {
+				return rating >= 290;
+			}, options);
+		ASSERT_EQUAL_HINT(high_rated.size(), 5u, policy_str);
+
+		options.document_sets.push_back("first_half"s);
+		const auto both = search_server.FindTopDocuments(policy, "cat"s, DocumentStatus::BANNED, options);
+		ASSERT_EQUAL_HINT(both.size(), 3u, policy_str);
+		ASSERT_EQUAL_HINT(both[0].id, 150, policy_str);
+		ASSERT_EQUAL_HINT(both[1].id, 6, policy_str);
+		ASSERT_EQUAL_HINT(both[2].id, 0, policy_str);
+	}
+
+	// Удаленные документы выбывают из множеств и после перенумерации
+	for (int id = 0; id < 250; ++id) {
+		search_server.RemoveDocument(id);
+	}
+	SearchOptions options;
+	options.top_k = 1'000;
+	options.document_sets = {"tenant"s};
+	ASSERT_EQUAL_HINT(search_server.FindTopDocuments(policy, "cat"s, DocumentStatus::ACTUAL, options).size(),
+		17u, policy_str);
+	options.document_sets = {"first_half"s};
+	ASSERT_EQUAL_HINT(search_server.FindTopDocuments(policy, "cat"s, DocumentStatus::ACTUAL, options).size(),
+		0u, policy_str);
+
+	// Неизвестное и удаленное множества - ошибка запроса
+	search_server.RemoveDocumentSet("tenant"s);
+	for (const std::string & name : {"unknown"s, "tenant"s}) {
+		options.document_sets = {name};
+		bool has_invalid_argument_exception = false;
+		try {
+			search_server.FindTopDocuments(policy, "cat"s, DocumentStatus::ACTUAL, options);
+		} catch (const std::invalid_argument &) {
+			has_invalid_argument_exception = true;
+		}
+		ASSERT_HINT(has_invalid_argument_exception, policy_str + " set: "s + name);
+	}
+}
+
+void TestDocumentSets() {
+	TestDocumentSetsPolicy(std::execution::seq);
+	TestDocumentSetsPolicy(std::execution::par);
+
+	SearchServer search_server(""s);
+	search_server.AddDocument(1, "cat"s, DocumentStatus::ACTUAL, {1});
+	bool has_invalid_argument_exception = false;
+	try {
+		search_server.SetDocumentSet("tenant"s, {1, 2});
+	} catch (const std::invalid_argument &) {
+		has_invalid_argument_exception = true;
+	}
+	ASSERT(has_invalid_argument_exception);
+}
+
+// Проверяет таблицу данных документов: поиск номера по id и перенумерацию
+void TestDocumentTable() {
+	DocumentTable documents;
+	for (int i = 0; i < 5; ++i) {
+		const DocumentOrdinal ordinal = documents.Add(i * 10, i, DocumentStatus::ACTUAL,
+			static_cast<uint32_t>(i + 1), {{static_cast<InvertedIndex::TermId>(i), 1.0}});
+		ASSERT_EQUAL(ordinal, static_cast<DocumentOrdinal>(i));
+	}
+	documents.Remove(1);
+	documents.Remove(3);
+	ASSERT(!documents.Contains(10));
+	ASSERT(!documents.FindOrdinal(30));
+	ASSERT_EQUAL(documents.GetDocumentCount(), 3u);
+	ASSERT_EQUAL(documents.GetOrdinalCount(), 5u);
+	ASSERT_EQUAL(documents.GetRemovedCount(), 2u);
+
+	const std::vector<DocumentOrdinal> new_ordinals = documents.Compact();
+	ASSERT_EQUAL(new_ordinals[0], 0u);
+	ASSERT_EQUAL(new_ordinals[2], 1u);
+	ASSERT_EQUAL(new_ordinals[4], 2u);
+	ASSERT_EQUAL(documents.GetOrdinalCount(), 3u);
+	ASSERT_EQUAL(documents.GetRemovedCount(), 0u);
+	const DocumentOrdinal ordinal = documents.GetOrdinal(40);
+	ASSERT_EQUAL(ordinal, 2u);
+	ASSERT_EQUAL(documents.GetId(ordinal), 40);
+	ASSERT_EQUAL(documents.GetRating(ordinal), 4);
+	ASSERT_EQUAL(documents.GetLength(ordinal), 5u);
+	ASSERT_EQUAL(documents.GetTerms(ordinal).at(0).term_id, 4u);
+}
+
+// Проверяет, что пакетное добавление дает тот же сервер, что и добавление по одному
+void TestAddDocumentsBatch() {
+	ThreadPool thread_pool(2);
+	std::mt19937 generator;
+	const auto dictionary = GenerateDictionary(generator, 300, 6);
+	const auto texts = GenerateQueries(generator, dictionary, 1'000, 20);
+
+	SearchServer expected_server(dictionary[0]);
+	SearchServer search_server(dictionary[0]);
+	search_server.SetThreadPool(thread_pool);
+	std::vector<DocumentRecord> first_batch;
+	std::vector<DocumentRecord> second_batch;
+	for (int id = 0; id < static_cast<int>(texts.size()); ++id) {
+		const DocumentStatus status = id % 5 == 0 ? DocumentStatus::BANNED : DocumentStatus::ACTUAL;
+		expected_server.AddDocument(id, texts[id], status, {id % 7, id % 3});
+		auto & batch = id < 600 ? first_batch : second_batch;
+		batch.push_back({id, texts[id], status, {id % 7, id % 3}});
+	}
+	// Второй пакет дописывается к уже построенным спискам вхождений
+	search_server.AddDocuments(first_batch);
+	search_server.AddDocuments(second_batch);
+	search_server.AddDocuments({});
+
+	ASSERT_EQUAL(search_server.GetDocumentCount(), expected_server.GetDocumentCount());
+	for (int id = 0; id < static_cast<int>(texts.size()); ++id) {
+		ASSERT_EQUAL(search_server.GetWordFrequencies(id), expected_server.GetWordFrequencies(id));
+	}
+	for (int i = 0; i < 30; ++i) {
+		const std::string query = GenerateQueryStrict(generator, dictionary, 1 + i % 8, 0.2);
+		AssertEqualDocuments(expected_server.FindTopDocuments(query),
+			search_server.FindTopDocuments(query), "query: "s + query);
+	}
+
+	// Некорректный пакет не меняет сервер
+	const std::vector<std::vector<DocumentRecord>> wrong_batches = {
+		{{5'000, "cat", DocumentStatus::ACTUAL, {}}, {5'000, "dog", DocumentStatus::ACTUAL, {}}},
+		{{5'001, "cat", DocumentStatus::ACTUAL, {}}, {10, "dog", DocumentStatus::ACTUAL, {}}},
+		{{5'002, "cat", DocumentStatus::ACTUAL, {}}, {-1, "dog", DocumentStatus::ACTUAL, {}}},
+		{{5'003, "cat", DocumentStatus::ACTUAL, {}}, {5'004, "d\x12og", DocumentStatus::ACTUAL, {}}},
+	};
+	for (const auto & batch : wrong_batches) {
+		bool is_thrown = false;
+		try {
+			search_server.AddDocuments(batch);
+		} catch (const std::invalid_argument &) {
+			is_thrown = true;
+		}
+		ASSERT(is_thrown);
+		ASSERT_EQUAL(search_server.GetDocumentCount(), expected_server.GetDocumentCount());
+		ASSERT(search_server.GetWordFrequencies(5'000).empty());
+		ASSERT(search_server.GetWordFrequencies(5'003).empty());
+	}
+}
+
+// Проверяет, что сервер, прочитанный из снимка, отвечает так же, как исходный
+void TestSnapshotRoundTrip() {
+	std::mt19937 generator;
+	const auto dictionary = GenerateDictionary(generator, 300, 6);
+	SearchServer search_server(std::vector<std::string>{dictionary[0], dictionary[1]});
+	AddRandomDocuments(search_server, generator, dictionary, 1'000, 20);
+	// Частое слово дает списку полные сжатые блоки, которые тоже перенумеровываются при записи
+	for (int id = 1'000; id < 1'400; ++id) {
+		search_server.AddDocument(id, dictionary[2] + " "s + dictionary[3 + id % 50], DocumentStatus::ACTUAL, {id % 7});
+	}
+	search_server.AddDocument(5'000, "", DocumentStatus::IRRELEVANT, {-4});
+	for (int id = 0; id < 1'400; id += 3) {
+		search_server.RemoveDocument(id);
+	}
+
+	const std::string path = (std::filesystem::temp_directory_path() / "search_server_test.snapshot").string();
+	search_server.SaveSnapshot(path);
+	const SearchServer loaded_server = SearchServer::LoadSnapshot(path);
+
+	ASSERT_EQUAL(loaded_server.GetDocumentCount(), search_server.GetDocumentCount());
+	ASSERT(std::equal(loaded_server.begin(), loaded_server.end(), search_server.begin(), search_server.end()));
+	for (const int document_id : search_server) {
+		ASSERT_EQUAL(loaded_server.GetWordFrequencies(document_id), search_server.GetWordFrequencies(document_id));
+	}
+	for (int i = 0; i < 30; ++i) {
+		// В запросах встречаются стоп-слова, они тоже должны восстановиться
+		const std::string query = dictionary[i % 2] + " "s + (i % 3 == 0 ? dictionary[2] + " "s : ""s)
+			+ GenerateQueryStrict(generator, dictionary, 1 + i % 8, 0.2);
+		for (DocumentStatus status : {DocumentStatus::ACTUAL, DocumentStatus::BANNED}) {
+			AssertEqualDocuments(search_server.FindTopDocuments(query, status),
+				loaded_server.FindTopDocuments(query, status), "query: "s + query);
+		}
+		const auto [words, status] = loaded_server.MatchDocument(query, 1);
+		const auto [expected_words, expected_status] = search_server.MatchDocument(query, 1);
+		ASSERT_EQUAL(words, expected_words);
+		ASSERT(status == expected_status);
+	}
+	ASSERT(std::get<1>(loaded_server.MatchDocument("cat"s, 5'000)) == DocumentStatus::IRRELEVANT);
+
+	// Усеченный файл и файл другого формата отвергаются
+	const auto is_rejected = [&path] {
+		try {
+			SearchServer::LoadSnapshot(path);
+		} catch (const std::runtime_error &) {
+			return true;
+		}
+		return false;
+	};
+	std::filesystem::resize_file(path, std::filesystem::file_size(path) - 1);
+	ASSERT(is_rejected());
+	std::ofstream(path, std::ios::binary) << "not a snapshot"s;
+	ASSERT(is_rejected());
+	std::filesystem::remove(path);
+	ASSERT(is_rejected());
+}
+
+// Проверяет параллельные методы на пуле потоков, переданном серверу
+void TestSearchWithOwnThreadPool() {
+	ThreadPool thread_pool(3);
+	std::mt19937 generator;
+	const auto dictionary = GenerateDictionary(generator, 300, 6);
+	SearchServer search_server(dictionary[0]);
+	search_server.SetThreadPool(thread_pool);
+	ASSERT_EQUAL(&search_server.GetThreadPool(), &thread_pool);
+	AddRandomDocuments(search_server, generator, dictionary, 2'000, 20);
+
+	SearchServer expected_server = search_server;
+	for (int id = 0; id < 2'000; id += 5) {
+		search_server.RemoveDocument(std::execution::par, id);
+		expected_server.RemoveDocument(std::execution::seq, id);
+	}
+	ASSERT_EQUAL(search_server.GetDocumentCount(), expected_server.GetDocumentCount());
+
+	SearchOptions options;
+	options.partition_count = 4;
+	for (int i = 0; i < 20; ++i) {
+		const std::string query = GenerateQueryStrict(generator, dictionary, 1 + i % 8, 0.2);
+		AssertEqualDocuments(
+			expected_server.FindTopDocuments(std::execution::seq, query, DocumentStatus::ACTUAL, options),
+			search_server.FindTopDocuments(std::execution::par, query, DocumentStatus::ACTUAL, options),
+			"query: "s + query);
+	}
+}
+
+// Проверяет разбиение на слова с проверкой управляющих символов и совпадение SIMD и скалярной версий
+void TestSplitIntoValidWords() {
+	std::vector<std::string_view> words;
+	const std::string text = "  white cat  and\xc3\xa9 -collar "s;
+	ASSERT(SplitIntoValidWordsView(text, words));
+	ASSERT_EQUAL(words, std::vector<std::string_view>({"white", "cat", "and\xc3\xa9", "-collar"}));
+	ASSERT(SplitIntoValidWordsView(""s, words));
+	ASSERT(words.empty());
+	ASSERT(!SplitIntoValidWordsView("white cat with a very long tail\tand fancy collar"s, words));
+
+	std::mt19937 generator;
+	const std::string alphabet = "  ab-\xc3\x7f"s;
+	std::vector<std::string_view> scalar_words;
+	for (int i = 0; i < 2'000; ++i) {
+		std::string random_text(std::uniform_int_distribution<size_t>(0, 100)(generator), ' ');
+		for (char & c : random_text) {
+			c = alphabet[std::uniform_int_distribution<size_t>(0, alphabet.size() - 1)(generator)];
+		}
+		if (i % 4 == 0 && !random_text.empty()) {
+			random_text[std::uniform_int_distribution<size_t>(0, random_text.size() - 1)(generator)] = '\n';
+		}
+		const bool is_valid = SplitIntoValidWordsView(random_text, words);
+		ASSERT_EQUAL(is_valid, SplitIntoValidWordsViewScalar(random_text, scalar_words));
+		ASSERT_EQUAL(is_valid, random_text.find('\n') == std::string::npos);
+		if (is_valid) {
+			ASSERT_EQUAL(words, scalar_words);
+			ASSERT_EQUAL(words, SplitIntoWordsView(random_text));
+		}
+	}
+}
+
+// Проверяет кэш результатов: ключ по нормализованному запросу и сброс при изменении индекса
+void TestResultCache() {
+	SearchServer search_server("and in"s);
+	search_server.AddDocument(1, "white cat and fancy collar"s, DocumentStatus::ACTUAL, {8, -3});
+	search_server.AddDocument(2, "fluffy cat fluffy tail"s, DocumentStatus::ACTUAL, {7, 2, 7});
+	search_server.AddDocument(3, "groomed dog expressive eyes"s, DocumentStatus::BANNED, {5, -12, 2, 1});
+	ASSERT_EQUAL(search_server.GetResultCacheStats().misses, 0u);
+
+	search_server.EnableResultCache(8, 2);
+	const auto expected = search_server.FindTopDocuments("fluffy cat -dog"s);
+	ASSERT_EQUAL(search_server.GetResultCacheStats().misses, 1u);
+	// Порядок слов, повторы и стоп-слова не меняют ключ
+	AssertEqualDocuments(search_server.FindTopDocuments("cat and fluffy -dog cat"s), expected, "normalized query"s);
+	AssertEqualDocuments(search_server.FindTopDocuments(std::execution::par, "-dog cat fluffy"s), expected,
+		"parallel version"s);
+	ASSERT_EQUAL(search_server.GetResultCacheStats().hits, 2u);
+	ASSERT_EQUAL(search_server.GetResultCacheStats().misses, 1u);
+
+	// Статус и top_k входят в ключ
+	ASSERT(search_server.FindTopDocuments("fluffy cat -dog"s, DocumentStatus::BANNED).empty());
+	SearchOptions options;
+	options.top_k = 1;
+	ASSERT_EQUAL(search_server.FindTopDocuments("fluffy cat -dog"s, DocumentStatus::ACTUAL, options).size(), 1u);
+	ASSERT_EQUAL(search_server.GetResultCacheStats().misses, 3u);
+	ASSERT_EQUAL(search_server.GetResultCacheStats().size, 3u);
+
+	// Новый документ делает сохраненные результаты устаревшими
+	search_server.AddDocument(4, "fluffy fluffy cat"s, DocumentStatus::ACTUAL, {1});
+	const auto after_add = search_server.FindTopDocuments("fluffy cat -dog"s);
+	ASSERT_EQUAL(after_add.size(), 3u);
+	ASSERT_EQUAL(after_add[0].id, 4);
+	ASSERT_EQUAL(search_server.GetResultCacheStats().misses, 4u);
+
+	search_server.RemoveDocument(4);
+	AssertEqualDocuments(search_server.FindTopDocuments("fluffy cat -dog"s), expected, "after remove"s);
+	ASSERT_EQUAL(search_server.GetResultCacheStats().misses, 5u);
+
+	search_server.SetDocumentSet("cats"s, {1});
+	options.top_k = MAX_RESULT_DOCUMENT_COUNT;
+	options.document_sets = {"cats"s};
+	ASSERT_EQUAL(search_server.FindTopDocuments("fluffy cat"s, DocumentStatus::ACTUAL, options).size(), 1u);
+	search_server.SetDocumentSet("cats"s, {1, 2});
+	ASSERT_EQUAL(search_server.FindTopDocuments("fluffy cat"s, DocumentStatus::ACTUAL, options).size(), 2u);
+
+	// Запросы с предикатом не кэшируются
+	const auto stats = search_server.GetResultCacheStats();
+	search_server.FindTopDocuments("fluffy cat"s, [](int, DocumentStatus, int) {
+		return true;
+	});
+	ASSERT_EQUAL(search_server.GetResultCacheStats().misses, stats.misses);
+	ASSERT_EQUAL(search_server.GetResultCacheStats().hits, stats.hits);
+
+	// Кэш ограничен по размеру
+	search_server.EnableResultCache(2, 1);
+	search_server.FindTopDocuments("cat"s);
+	search_server.FindTopDocuments("dog"s);
+	search_server.FindTopDocuments("tail"s);
+	ASSERT_EQUAL(search_server.GetResultCacheStats().size, 2u);
+	search_server.FindTopDocuments("cat"s);
+	ASSERT_EQUAL(search_server.GetResultCacheStats().hits, 0u);
+	ASSERT_EQUAL(search_server.GetResultCacheStats().misses, 4u);
+
+	search_server.DisableResultCache();
+	search_server.FindTopDocuments("cat"s);
+	ASSERT_EQUAL(search_server.GetResultCacheStats().misses, 0u);
+}
+
+// Проверяет поиск с переиспользуемым контекстом запроса
+void TestQueryContext() {
+	std::mt19937 generator;
+	const auto dictionary = GenerateDictionary(generator, 300, 6);
+	SearchServer search_server(dictionary[0]);
+	AddRandomDocuments(search_server, generator, dictionary, 2'000, 20);
+
+	SearchServer::QueryContext context;
+	SearchOptions options;
+	for (int i = 0; i < 60; ++i) {
+		options.top_k = 1 + i % 12;
+		options.strategy = i % 2 == 0 ? ScoringStrategy::EXHAUSTIVE : ScoringStrategy::MAX_SCORE;
+		const std::string query = GenerateQueryStrict(generator, dictionary, 1 + i % 8, 0.2);
+		const auto & documents = search_server.FindTopDocuments(context, query, DocumentStatus::ACTUAL, options);
+		ASSERT_EQUAL(&documents, &context.GetResults());
+		AssertEqualDocuments(documents,
+			search_server.FindTopDocuments(query, DocumentStatus::ACTUAL, options), "query: "s + query);
+	}
+
+	// После ошибки разбора контекст остается пригодным
+	bool is_rejected = false;
+	try {
+		search_server.FindTopDocuments(context, "--"s + dictionary[1]);
+	} catch (const std::invalid_argument &) {
+		is_rejected = true;
+	}
+	ASSERT(is_rejected);
+	AssertEqualDocuments(search_server.FindTopDocuments(context, dictionary[1]),
+		search_server.FindTopDocuments(dictionary[1]), "after error"s);
+
+	// Вложенный запрос из фильтра получает свой контекст потока
+	const auto expected = search_server.FindTopDocuments(dictionary[2]);
+	const auto nested = search_server.FindTopDocuments(dictionary[2],
+		[&](int, DocumentStatus status, int) {
+			return search_server.FindTopDocuments(dictionary[3]).size() <= MAX_RESULT_DOCUMENT_COUNT
+				&& status == DocumentStatus::ACTUAL;
+		});
+	AssertEqualDocuments(nested, expected, "nested query"s);
+
+	search_server.EnableResultCache(16);
+	AssertEqualDocuments(search_server.FindTopDocuments(context, dictionary[2]), expected, "cache miss"s);
+	AssertEqualDocuments(search_server.FindTopDocuments(context, dictionary[2]), expected, "cache hit"s);
+	ASSERT_EQUAL(search_server.GetResultCacheStats().hits, 1u);
+}
+
+// Тест проверяет, что повторные запросы через один контекст не выделяют память,
+// когда буферы контекста уже выросли до нужного размера
+void TestQueryContextAllocations() {
+	std::mt19937 generator;
+	const auto dictionary = GenerateDictionary(generator, 300, 6);
+	SearchServer search_server(dictionary[0]);
+	AddRandomDocuments(search_server, generator, dictionary, 2'000, 20);
+	std::vector<std::string> queries;
+	for (int i = 0; i < 100; ++i) {
+		queries.push_back(GenerateQueryStrict(generator, dictionary, 1 + i % 8, 0.2));
+	}
+
+	SearchServer::QueryContext context;
+	SearchOptions options;
+	options.strategy = ScoringStrategy::EXHAUSTIVE;
+	const auto run_queries = [&] {
+		for (const std::string & query : queries) {
+			search_server.FindTopDocuments(context, query, DocumentStatus::ACTUAL, options);
+		}
+	};
+	run_queries();
+	// Счетчик читается до вызова ASSERT, который сам создает строки
+	size_t allocation_count = GetAllocationCount();
+	run_queries();
+	run_queries();
+	allocation_count = GetAllocationCount() - allocation_count;
+	ASSERT_EQUAL_HINT(allocation_count, 0u, "exhaustive"s);
+
+	// Курсоры и границы слов MaxScore хранятся в контексте
+	options.strategy = ScoringStrategy::MAX_SCORE;
+	run_queries();
+	allocation_count = GetAllocationCount();
+	run_queries();
+	run_queries();
+	allocation_count = GetAllocationCount() - allocation_count;
+	ASSERT_EQUAL_HINT(allocation_count, 0u, "max score"s);
+
+	// По одной записи на часть кэша: каждый запрос промахивается и вытесняет запись,
+	// память которой достается новой
+	search_server.EnableResultCache(ResultCache::DEFAULT_SHARD_COUNT);
+	run_queries();
+	allocation_count = GetAllocationCount();
+	run_queries();
+	allocation_count = GetAllocationCount() - allocation_count;
+	ASSERT_EQUAL(search_server.GetResultCacheStats().hits, 0u);
+	ASSERT_EQUAL_HINT(allocation_count, 0u, "evicting"s);
+
+	// Емкость с запасом, чтобы неравномерное разбиение на части кэша ничего не вытеснило
+	search_server.EnableResultCache(16 * queries.size());
+	run_queries();
+	const size_t hit_count = search_server.GetResultCacheStats().hits;
+	allocation_count = GetAllocationCount();
+	run_queries();
+	allocation_count = GetAllocationCount() - allocation_count;
+	ASSERT_EQUAL(search_server.GetResultCacheStats().hits - hit_count, queries.size());
+	ASSERT_EQUAL_HINT(allocation_count, 0u, "cached"s);
+}
+
 void TestSearchServer() {
 	RUN_TEST(TestCreateSearchServer);
 	RUN_TEST(TestAddingDocuments);
@@ -649,6 +1677,28 @@ void TestSearchServer() {
 	RUN_TEST(TestFindingDocumentsByStatus);
 	RUN_TEST(TestCalculateRelevanceOfFindingDocs);
 	RUN_TEST(TestWordsTfInDocument);
+	RUN_TEST(TestWordFrequenciesReference);
+	RUN_TEST(TestDocumentTerms);
 	RUN_TEST(TestBeginEnd);
 	RUN_TEST(TestRemoveDocument);
+	RUN_TEST(TestRemoveDocuments);
+	RUN_TEST(TestSearchAfterOrdinalCompaction);
+	RUN_TEST(TestSearchBeforeCompaction);
+	RUN_TEST(TestSearchAfterPostingsPurge);
+	RUN_TEST(TestTermPurgeOnCompaction);
+	RUN_TEST(TestMatchedWordsSurviveRemoval);
+	RUN_TEST(TestTopKInFindTopDocuments);
+	RUN_TEST(TestMaxScoreMatchesExhaustive);
+	RUN_TEST(TestPartitionedParallelSearch);
+	RUN_TEST(TestParallelSearchWithFilter);
+	RUN_TEST(TestFrequentMinusWords);
+	RUN_TEST(TestDocumentSets);
+	RUN_TEST(TestDocumentTable);
+	RUN_TEST(TestSearchWithOwnThreadPool);
+	RUN_TEST(TestAddDocumentsBatch);
+	RUN_TEST(TestSnapshotRoundTrip);
+	RUN_TEST(TestSplitIntoValidWords);
+	RUN_TEST(TestResultCache);
+	RUN_TEST(TestQueryContext);
+	RUN_TEST(TestQueryContextAllocations);
 }
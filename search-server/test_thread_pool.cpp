@@ -0,0 +1,73 @@
+#include "test_thread_pool.h"
+#include "thread_pool.h"
+#include "test_engine.h"
+#include <atomic>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+using std::literals::string_literals::operator""s;
+
+// Проверяет, что каждый индекс обрабатывается ровно один раз
+void TestParallelForVisitsEachIndexOnce() {
+	for (size_t thread_count : {0u, 1u, 3u}) {
+		ThreadPool pool(thread_count);
+		ASSERT_EQUAL(pool.GetConcurrency(), thread_count + 1);
+		for (size_t count : {0u, 1u, 2u, 1000u}) {
+			std::vector<std::atomic<int>> visits(count);
+			pool.ParallelFor(count, [&visits](size_t i) {
+				++visits[i];
+			});
+			for (size_t i = 0; i < count; ++i) {
+				ASSERT_EQUAL_HINT(visits[i].load(), 1,
+					"threads: "s + std::to_string(thread_count) + " index: "s + std::to_string(i));
+			}
+		}
+	}
+}
+
+// Проверяет, что вложенные вызовы не блокируют пул, даже если задач больше, чем потоков
+void TestNestedParallelFor() {
+	ThreadPool pool(2, true);
+	std::atomic<int> total = 0;
+	pool.ParallelFor(8, [&](size_t) {
+		pool.ParallelFor(8, [&](size_t) {
+			pool.ParallelFor(4, [&](size_t) {
+				++total;
+			});
+		});
+	});
+	ASSERT_EQUAL(total.load(), 8 * 8 * 4);
+}
+
+// Проверяет, что исключение из задачи доходит до вызывающего, а остальные индексы обработаны
+void TestParallelForException() {
+	ThreadPool pool(3);
+	std::atomic<int> processed = 0;
+	bool is_thrown = false;
+	try {
+		pool.ParallelFor(100, [&processed](size_t i) {
+			if (i == 42) {
+				throw std::runtime_error("task failed"s);
+			}
+			++processed;
+		});
+	} catch (const std::runtime_error &) {
+		is_thrown = true;
+	}
+	ASSERT(is_thrown);
+	ASSERT_EQUAL(processed.load(), 99);
+
+	// Пул остается рабочим после исключения
+	std::atomic<int> visits = 0;
+	pool.ParallelFor(10, [&visits](size_t) {
+		++visits;
+	});
+	ASSERT_EQUAL(visits.load(), 10);
+}
+
+void TestThreadPool() {
+	RUN_TEST(TestParallelForVisitsEachIndexOnce);
+	RUN_TEST(TestNestedParallelFor);
+	RUN_TEST(TestParallelForException);
+}
@@ -0,0 +1,4 @@
+#pragma once
+
+// Функция является точкой входа для запуска тестов пула потоков
+void TestThreadPool();
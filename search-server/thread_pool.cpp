@@ -0,0 +1,178 @@
+#include "thread_pool.h"
+
+#include <algorithm>
+#include <exception>
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+namespace {
+
+// Пул и очередь, которым принадлежит текущий поток
+thread_local const ThreadPool * local_pool = nullptr;
+thread_local size_t local_queue_index = 0;
+
+} // namespace
+
+ThreadPool::ThreadPool(size_t thread_count, bool pin_to_cores) {
+	queues_.reserve(thread_count);
+	for (size_t i = 0; i < thread_count; ++i) {
+		queues_.push_back(std::make_unique<WorkQueue>());
+	}
+	threads_.reserve(thread_count);
+	for (size_t i = 0; i < thread_count; ++i) {
+		threads_.emplace_back([this, i, pin_to_cores] {
+			WorkerLoop(i, pin_to_cores);
+		});
+	}
+}
+
+ThreadPool::~ThreadPool() {
+	{
+		std::lock_guard lock(wake_mutex_);
+		stop_ = true;
+	}
+	wake_.notify_all();
+	for (std::thread & thread : threads_) {
+		thread.join();
+	}
+}
+
+size_t ThreadPool::GetThreadCount() const {
+	return threads_.size();
+}
+
+size_t ThreadPool::GetConcurrency() const {
+	return threads_.size() + 1;
+}
+
+void ThreadPool::ParallelFor(size_t count, const std::function<void(size_t)> & function) {
+	if (count == 0) {
+		return;
+	}
+	struct State {
+		std::atomic<size_t> next = 0;
+		std::atomic<size_t> done = 0;
+		std::mutex exception_mutex;
+		std::exception_ptr exception;
+	};
+	// Задача-помощник может достаться потоку уже после возврата из ParallelFor,
+	// поэтому состояние разделяемое, а function вызывается только для невыданных i
+	auto state = std::make_shared<State>();
+	auto run = [state, &function, count] {
+		for (size_t i = state->next++; i < count; i = state->next++) {
+			try {
+				function(i);
+			} catch (...) {
+				std::lock_guard lock(state->exception_mutex);
+				if (!state->exception) {
+					state->exception = std::current_exception();
+				}
+			}
+			++state->done;
+		}
+	};
+
+	const size_t helper_count = std::min(count, GetConcurrency()) - 1;
+	for (size_t i = 0; i < helper_count; ++i) {
+		Submit(run);
+	}
+	run();
+	// Пока другие потоки доделывают свои i, помогаем пулу, а не простаиваем
+	while (state->done < count) {
+		if (!TryRunTask()) {
+			std::this_thread::yield();
+		}
+	}
+	if (state->exception) {
+		std::rethrow_exception(state->exception);
+	}
+}
+
+ThreadPool & ThreadPool::GetDefault() {
+	static ThreadPool pool(std::max(1u, std::thread::hardware_concurrency()) - 1);
+	return pool;
+}
+
+void ThreadPool::Submit(Task task) {
+	const size_t local_index = GetLocalQueueIndex();
+	const size_t index = local_index < queues_.size()
+		? local_index
+		: next_queue_++ % queues_.size();
+	// Счетчик увеличивается до публикации задачи, чтобы не уйти ниже нуля при ее перехвате
+	++pending_tasks_;
+	{
+		std::lock_guard lock(queues_[index]->mutex);
+		queues_[index]->tasks.push_back(std::move(task));
+	}
+	{
+		std::lock_guard lock(wake_mutex_);
+	}
+	wake_.notify_one();
+}
+
+bool ThreadPool::TryRunTask() {
+	if (queues_.empty()) {
+		return false;
+	}
+	const size_t local_index = GetLocalQueueIndex();
+	Task task;
+	if (local_index < queues_.size()) {
+		WorkQueue & queue = *queues_[local_index];
+		std::lock_guard lock(queue.mutex);
+		if (!queue.tasks.empty()) {
+			task = std::move(queue.tasks.back());
+			queue.tasks.pop_back();
+		}
+	}
+	for (size_t i = 1; !task && i <= queues_.size(); ++i) {
+		WorkQueue & queue = *queues_[(local_index + i) % queues_.size()];
+		std::lock_guard lock(queue.mutex);
+		if (!queue.tasks.empty()) {
+			task = std::move(queue.tasks.front());
+			queue.tasks.pop_front();
+		}
+	}
+	if (!task) {
+		return false;
+	}
+	--pending_tasks_;
+	task();
+	return true;
+}
+
+void ThreadPool::WorkerLoop(size_t index, bool pin_to_core) {
+	local_pool = this;
+	local_queue_index = index;
+	if (pin_to_core) {
+		PinCurrentThread(index);
+	}
+	while (true) {
+		if (TryRunTask()) {
+			continue;
+		}
+		std::unique_lock lock(wake_mutex_);
+		wake_.wait(lock, [this] {
+			return stop_ || pending_tasks_ > 0;
+		});
+		if (stop_ && pending_tasks_ == 0) {
+			return;
+		}
+	}
+}
+
+size_t ThreadPool::GetLocalQueueIndex() const {
+	return local_pool == this ? local_queue_index : queues_.size();
+}
+
+void ThreadPool::PinCurrentThread([[maybe_unused]] size_t core) {
+#ifdef __linux__
+	const size_t core_count = std::max(1u, std::thread::hardware_concurrency());
+	cpu_set_t cpu_set;
+	CPU_ZERO(&cpu_set);
+	CPU_SET(core % core_count, &cpu_set);
+	// Если закрепить не удалось, поток просто работает без привязки
+	pthread_setaffinity_np(pthread_self(), sizeof(cpu_set), &cpu_set);
+#endif
+}
@@ -0,0 +1,64 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Пул потоков с перехватом задач (work stealing).
+// У каждого рабочего потока своя очередь: поток берет задачи с конца своей очереди,
+// а при ее опустошении забирает задачи из начала чужих.
+// Поток, ожидающий завершения ParallelFor, сам выполняет задачи пула, поэтому
+// вложенные вызовы ParallelFor из задач не создают новых потоков и не блокируют пул
+class ThreadPool {
+public:
+	// thread_count - число рабочих потоков, вызывающий поток работает вместе с ними.
+	// При pin_to_cores рабочий поток i закрепляется за ядром i по модулю числа ядер
+	explicit ThreadPool(size_t thread_count, bool pin_to_cores = false);
+	~ThreadPool();
+
+	ThreadPool(const ThreadPool &) = delete;
+	ThreadPool & operator=(const ThreadPool &) = delete;
+
+	size_t GetThreadCount() const;
+	// Число потоков, одновременно выполняющих ParallelFor, с учетом вызывающего
+	size_t GetConcurrency() const;
+
+	// Выполняет function(i) для всех i из [0, count) и дожидается завершения.
+	// Первое выброшенное исключение пробрасывается вызывающему после завершения остальных i
+	void ParallelFor(size_t count, const std::function<void(size_t)> & function);
+
+	// Общий пул процесса: число рабочих потоков на один меньше числа ядер
+	static ThreadPool & GetDefault();
+
+private:
+	using Task = std::function<void()>;
+
+	struct WorkQueue {
+		std::mutex mutex;
+		std::deque<Task> tasks;
+	};
+
+	std::vector<std::unique_ptr<WorkQueue>> queues_;
+	std::vector<std::thread> threads_;
+	std::atomic<size_t> next_queue_ = 0;
+
+	std::mutex wake_mutex_;
+	std::condition_variable wake_;
+	std::atomic<size_t> pending_tasks_ = 0;
+	bool stop_ = false;
+
+	void Submit(Task task);
+	// Выполняет одну задачу: сначала из своей очереди, затем из чужих
+	bool TryRunTask();
+	void WorkerLoop(size_t index, bool pin_to_core);
+	// Индекс очереди текущего потока или queues_.size(), если поток не из этого пула
+	size_t GetLocalQueueIndex() const;
+
+	static void PinCurrentThread(size_t core);
+};
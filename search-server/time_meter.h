@@ -6,6 +6,7 @@
 #include <vector>
 #include "log_duration.h"
 #include <execution>
+#include <filesystem>
 
 template <typename QueriesProcessor>
 void TestQueriesProcessor(std::string_view mark, QueriesProcessor processor,
@@ -16,6 +17,47 @@ void TestQueriesProcessor(std::string_view mark, QueriesProcessor processor,
 }
 #define TEST_TIME_QUERIES_PROCESSOR(processor) TestQueriesProcessor(#processor, processor, search_server, queries)
 
+inline void TestDocumentsLoading(std::string_view mark, const std::string& stop_words,
+	const std::vector<std::string>& documents, bool is_batch)
+{
+	LOG_DURATION(mark);
+	SearchServer search_server(stop_words);
+	if (is_batch) {
+		std::vector<DocumentRecord> records;
+		records.reserve(documents.size());
+		for (size_t i = 0; i < documents.size(); ++i) {
+			records.push_back({static_cast<int>(i), documents[i], DocumentStatus::ACTUAL, {1, 2, 3}});
+		}
+		search_server.AddDocuments(records);
+	} else {
+		for (size_t i = 0; i < documents.size(); ++i) {
+			search_server.AddDocument(i, documents[i], DocumentStatus::ACTUAL, {1, 2, 3});
+		}
+	}
+	std::cout << search_server.GetDocumentCount() << std::endl;
+}
+#define TEST_DOCUMENTS_LOADING(method, is_batch) TestDocumentsLoading(#method, dictionary[0], documents, is_batch)
+
+inline void TestSnapshotLoading(std::string_view mark, const std::string& stop_words,
+	const std::vector<std::string>& documents)
+{
+	const std::string path = (std::filesystem::temp_directory_path() / "search_server_benchmark.snapshot").string();
+	{
+		SearchServer search_server(stop_words);
+		for (size_t i = 0; i < documents.size(); ++i) {
+			search_server.AddDocument(i, documents[i], DocumentStatus::ACTUAL, {1, 2, 3});
+		}
+		search_server.SaveSnapshot(path);
+	}
+	{
+		LOG_DURATION(mark);
+		const SearchServer search_server = SearchServer::LoadSnapshot(path);
+		std::cout << search_server.GetDocumentCount() << std::endl;
+	}
+	std::filesystem::remove(path);
+}
+#define TEST_SNAPSHOT_LOADING() TestSnapshotLoading("LoadSnapshot", dictionary[0], documents)
+
 template <typename ExecutionPolicy>
 void TestMultiThreadRemoving(std::string_view mark,
 	SearchServer search_server, ExecutionPolicy&& policy)
@@ -30,6 +72,26 @@ void TestMultiThreadRemoving(std::string_view mark,
 
 #define TEST_MULTI_THREAD_REMOVING(mode) TestMultiThreadRemoving(#mode, search_server, std::execution::mode)
 
+// Удаляет каждый десятый документ по одному или одним пакетом
+inline void TestBatchRemoving(std::string_view mark, SearchServer search_server, bool is_batch) {
+	LOG_DURATION(mark);
+	const int document_count = search_server.GetDocumentCount();
+	std::vector<int> document_ids;
+	for (int id = 0; id < document_count; id += 10) {
+		document_ids.push_back(id);
+	}
+	if (is_batch) {
+		search_server.RemoveDocuments(document_ids);
+	} else {
+		for (const int id : document_ids) {
+			search_server.RemoveDocument(id);
+		}
+	}
+	std::cout << search_server.GetDocumentCount() << std::endl;
+}
+
+#define TEST_BATCH_REMOVING(method, is_batch) TestBatchRemoving(#method, search_server, is_batch)
+
 
 template <typename ExecutionPolicy>
 void TestMultiThreadMatching(std::string_view mark, SearchServer search_server,
@@ -49,15 +111,18 @@ void TestMultiThreadMatching(std::string_view mark, SearchServer search_server,
 
 template <typename ExecutionPolicy>
 void TestMultiThreadFinding(std::string_view mark, const SearchServer& search_server,
-	const std::vector<std::string>& queries, ExecutionPolicy&& policy)
+	const std::vector<std::string>& queries, ExecutionPolicy&& policy,
+	const SearchOptions& options = {})
 {
 	LOG_DURATION(mark);
 	double total_relevance = 0;
 	for (const std::string_view query : queries) {
-		for (const auto& document : search_server.FindTopDocuments(policy, query)) {
+		for (const auto& document : search_server.FindTopDocuments(policy, query, DocumentStatus::ACTUAL, options)) {
 			total_relevance += document.relevance;
 		}
 	}
 	std::cout << total_relevance << std::endl;
 }
 #define TEST_MULTI_THREAD_FINDING(policy) TestMultiThreadFinding(#policy, search_server, queries, std::execution::policy)
+#define TEST_MULTI_THREAD_FINDING_STRATEGY(policy, strategy) TestMultiThreadFinding(#policy " " #strategy, search_server, queries, \
+	std::execution::policy, SearchOptions{MAX_RESULT_DOCUMENT_COUNT, ScoringStrategy::strategy, 0, {}})
@@ -0,0 +1,74 @@
+#include "top_documents.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace {
+
+// Больше мест заранее не выделяется: при большом capacity куча растет
+// по мере поступления документов, и top_k не обязан быть меньше числа документов
+constexpr size_t MAX_RESERVED_DOCUMENTS = 1024;
+
+} // namespace
+
+bool IsMoreRelevant(const Document & lhs, const Document & rhs) {
+	if (std::abs(lhs.relevance - rhs.relevance) < EPSILON) {
+		if (lhs.rating == rhs.rating) {
+			return lhs.id < rhs.id;
+		}
+		return lhs.rating > rhs.rating;
+	}
+	return lhs.relevance > rhs.relevance;
+}
+
+TopDocuments::TopDocuments(size_t capacity)
+	: capacity_(capacity)
+{
+	heap_.reserve(std::min(capacity_, MAX_RESERVED_DOCUMENTS));
+}
+
+void TopDocuments::Reset(size_t capacity) {
+	capacity_ = capacity;
+	heap_.clear();
+	heap_.reserve(std::min(capacity_, MAX_RESERVED_DOCUMENTS));
+}
+
+void TopDocuments::Push(const Document & document) {
+	if (heap_.size() < capacity_) {
+		heap_.push_back(document);
+		std::push_heap(heap_.begin(), heap_.end(), IsMoreRelevant);
+	} else if (capacity_ > 0 && IsMoreRelevant(document, heap_.front())) {
+		std::pop_heap(heap_.begin(), heap_.end(), IsMoreRelevant);
+		heap_.back() = document;
+		std::push_heap(heap_.begin(), heap_.end(), IsMoreRelevant);
+	}
+}
+
+void TopDocuments::Merge(const TopDocuments & other) {
+	for (const Document & document : other.heap_) {
+		Push(document);
+	}
+}
+
+size_t TopDocuments::GetCapacity() const {
+	return capacity_;
+}
+
+bool TopDocuments::IsFull() const {
+	return heap_.size() >= capacity_;
+}
+
+const Document & TopDocuments::GetWorst() const {
+	return heap_.front();
+}
+
+std::vector<Document> TopDocuments::Extract() && {
+	std::sort_heap(heap_.begin(), heap_.end(), IsMoreRelevant);
+	return std::move(heap_);
+}
+
+void TopDocuments::ExtractTo(std::vector<Document> & documents) {
+	std::sort_heap(heap_.begin(), heap_.end(), IsMoreRelevant);
+	documents.swap(heap_);
+	heap_.clear();
+}
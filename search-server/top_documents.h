@@ -0,0 +1,39 @@
+#pragma once
+
+#include <vector>
+#include "document.h"
+
+inline constexpr double EPSILON = 1e-6;
+
+// Порядок выдачи: по убыванию релевантности, при равной с точностью до EPSILON
+// релевантности - по убыванию рейтинга, затем по возрастанию id
+bool IsMoreRelevant(const Document & lhs, const Document & rhs);
+
+// Ограниченная куча, хранящая не более capacity лучших документов.
+// Вершина кучи - худший из сохраненных документов. Память под большую емкость
+// выделяется по мере заполнения
+class TopDocuments {
+public:
+	explicit TopDocuments(size_t capacity);
+
+	// Очищает кучу и задает новую емкость, сохраняя выделенную память
+	void Reset(size_t capacity);
+
+	void Push(const Document & document);
+	void Merge(const TopDocuments & other);
+
+	size_t GetCapacity() const;
+	bool IsFull() const;
+	// Худший из сохраненных документов. Куча не должна быть пустой
+	const Document & GetWorst() const;
+
+	// Возвращает документы, упорядоченные от лучшего к худшему
+	std::vector<Document> Extract() &&;
+	// Упорядочивает документы от лучшего к худшему и обменивает их с содержимым documents.
+	// Куча становится пустой, а ее память переходит к documents и обратно без выделений
+	void ExtractTo(std::vector<Document> & documents);
+
+private:
+	size_t capacity_;
+	std::vector<Document> heap_;
+};